@@ -0,0 +1,58 @@
+#include "Adam7.h"
+#include <cstring> // used for memcpy()
+
+const Adam7Pass Adam7Passes[ADAM7_PASSES] = {
+	{ 0, 0, 8, 8 },
+	{ 4, 0, 8, 8 },
+	{ 0, 4, 4, 8 },
+	{ 2, 0, 4, 4 },
+	{ 0, 2, 2, 4 },
+	{ 1, 0, 2, 2 },
+	{ 0, 1, 1, 2 }
+};
+
+template <size_t PixelSize>
+static void ScatterPixels(const byte_t *pixels, const uint32_t &count, byte_t *row, const uint32_t &x0, const uint32_t &dx)
+{
+	byte_t *output = row + (size_t)x0 * PixelSize;
+	for (uint32_t i = 0; i < count; i++, output += (size_t)dx * PixelSize)
+		memcpy(output, pixels + (size_t)i * PixelSize, PixelSize);
+}
+
+// Pixels smaller than a byte(only grayscale samples that are not converted), the other bits of the bytes are kept
+template <uint32_t BitsPerPixel>
+static void ScatterBits(const byte_t *pixels, const uint32_t &count, byte_t *row, const uint32_t &x0, const uint32_t &dx)
+{
+	const uint32_t mask = (1u << BitsPerPixel) - 1;
+	for (uint32_t i = 0; i < count; i++) {
+		size_t source = (size_t)i * BitsPerPixel;
+		uint32_t value = (pixels[source / 8] >> (8 - BitsPerPixel - source % 8)) & mask;
+		size_t target = ((size_t)x0 + (size_t)i * dx) * BitsPerPixel;
+		uint32_t shift = (uint32_t)(8 - BitsPerPixel - target % 8);
+		row[target / 8] = (byte_t)((row[target / 8] & ~(mask << shift)) | (value << shift));
+	}
+}
+
+void GetAdam7Scale(const uint32_t & passes, uint32_t & scaleX, uint32_t & scaleY)
+{
+	// The known pixels are as far apart as the pixels of the next pass
+	scaleX = (passes < ADAM7_PASSES) ? Adam7Passes[passes].dx : 1;
+	scaleY = (passes < ADAM7_PASSES) ? Adam7Passes[passes].dy : 1;
+}
+
+void ScatterRow(const byte_t * pixels, const uint32_t & count, byte_t * row, const uint32_t & x0, const uint32_t & dx, const size_t & bitsPerPixel)
+{
+	switch (bitsPerPixel)
+	{
+	case 1: ScatterBits<1>(pixels, count, row, x0, dx); break;
+	case 2: ScatterBits<2>(pixels, count, row, x0, dx); break;
+	case 4: ScatterBits<4>(pixels, count, row, x0, dx); break;
+	case 8: ScatterPixels<1>(pixels, count, row, x0, dx); break;
+	case 16: ScatterPixels<2>(pixels, count, row, x0, dx); break;
+	case 24: ScatterPixels<3>(pixels, count, row, x0, dx); break;
+	case 32: ScatterPixels<4>(pixels, count, row, x0, dx); break;
+	case 48: ScatterPixels<6>(pixels, count, row, x0, dx); break;
+	case 64: ScatterPixels<8>(pixels, count, row, x0, dx); break;
+	default: throw "Unsupported pixel size!";
+	}
+}
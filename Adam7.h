@@ -0,0 +1,22 @@
+#pragma once
+#include <Binary.h>
+
+#define ADAM7_PASSES 7
+
+// The pixels of an interlaced image that are stored in one Adam7 pass. Each pass is a reduced image
+// with its own scanlines and filters
+struct Adam7Pass {
+	uint32_t x0, y0; // The first pixel
+	uint32_t dx, dy; // Distance between the pixels of the pass
+
+	uint32_t Width(const uint32_t &imageWidth) const { return (imageWidth > x0) ? (imageWidth - x0 + dx - 1) / dx : 0; }
+	uint32_t Height(const uint32_t &imageHeight) const { return (imageHeight > y0) ? (imageHeight - y0 + dy - 1) / dy : 0; }
+};
+
+extern const Adam7Pass Adam7Passes[ADAM7_PASSES];
+
+// Every pixel of the image is known after the last pass. After the first "passes" passes only one pixel of each
+// "scaleX" x "scaleY" block is known(the top-left one), so a preview has the size of the image divided by the scale
+void GetAdam7Scale(const uint32_t &passes, uint32_t &scaleX, uint32_t &scaleY);
+// Copies "count" pixels of a reduced row to columns x0, x0 + dx, x0 + 2 * dx, ... of "row"
+void ScatterRow(const byte_t *pixels, const uint32_t &count, byte_t *row, const uint32_t &x0, const uint32_t &dx, const size_t &bitsPerPixel);
@@ -0,0 +1,141 @@
+#include "Adler32.h"
+#include "CPUFeatures.h"
+
+#ifdef PNG_X86
+#include <immintrin.h>
+#endif
+
+#define ADLER_BASE 65521 // The largest prime below 2^16
+#define ADLER_NMAX 5552 // The most bytes that can be added before the sums may overflow 32 bits
+#define ADLER_BLOCK 32 // Bytes processed by one iteration of the SIMD kernels
+
+static uint32_t Adler32Scalar(uint32_t adler, const byte_t *data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while (size > 0) {
+		size_t count = (size < ADLER_NMAX) ? size : ADLER_NMAX;
+		size -= count;
+		for (; count >= 4; count -= 4, data += 4) {
+			a += data[0]; b += a;
+			a += data[1]; b += a;
+			a += data[2]; b += a;
+			a += data[3]; b += a;
+		}
+		while (count-- > 0) {
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return (b << 16) | a;
+}
+
+#ifdef PNG_X86
+// For a block of 32 bytes "a" grows by their sum and "b" by the sum of the bytes weighted 32, 31, ..., 1 plus 32
+// times "a" from before the block. The previous "a" values are collected in "prefix" and multiplied only at the end
+TARGET_SSE41 static inline uint32_t HorizontalSum(const __m128i &v)
+{
+	__m128i sum = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+TARGET_SSE41 static uint32_t Adler32SSSE3(uint32_t adler, const byte_t *data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	size_t blocks = size / ADLER_BLOCK;
+	size -= blocks * ADLER_BLOCK;
+
+	const __m128i weightsHigh = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i weightsLow = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+	while (blocks > 0) {
+		size_t count = (blocks < ADLER_NMAX / ADLER_BLOCK) ? blocks : ADLER_NMAX / ADLER_BLOCK;
+		blocks -= count;
+
+		__m128i prefix = _mm_cvtsi32_si128((int)(a * count));
+		__m128i sumA = zero;
+		__m128i sumB = _mm_cvtsi32_si128((int)b);
+		for (; count > 0; count--, data += ADLER_BLOCK) {
+			__m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+			__m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+			prefix = _mm_add_epi32(prefix, sumA);
+			sumA = _mm_add_epi32(sumA, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+			sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weightsHigh), ones));
+			sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weightsLow), ones));
+		}
+		sumB = _mm_add_epi32(sumB, _mm_slli_epi32(prefix, 5));
+
+		a = (a + HorizontalSum(sumA)) % ADLER_BASE;
+		b = HorizontalSum(sumB) % ADLER_BASE;
+	}
+	return Adler32Scalar((b << 16) | a, data, size);
+}
+
+TARGET_AVX2 static uint32_t Adler32AVX2(uint32_t adler, const byte_t *data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	size_t blocks = size / ADLER_BLOCK;
+	size -= blocks * ADLER_BLOCK;
+
+	const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i zero = _mm256_setzero_si256();
+	while (blocks > 0) {
+		size_t count = (blocks < ADLER_NMAX / ADLER_BLOCK) ? blocks : ADLER_NMAX / ADLER_BLOCK;
+		blocks -= count;
+
+		__m256i prefix = _mm256_setr_epi32((int)(a * count), 0, 0, 0, 0, 0, 0, 0);
+		__m256i sumA = zero;
+		__m256i sumB = _mm256_setr_epi32((int)b, 0, 0, 0, 0, 0, 0, 0);
+		for (; count > 0; count--, data += ADLER_BLOCK) {
+			__m256i bytes = _mm256_loadu_si256((const __m256i*)data);
+			prefix = _mm256_add_epi32(prefix, sumA);
+			sumA = _mm256_add_epi32(sumA, _mm256_sad_epu8(bytes, zero));
+			sumB = _mm256_add_epi32(sumB, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+		}
+		sumB = _mm256_add_epi32(sumB, _mm256_slli_epi32(prefix, 5));
+
+		__m128i lanesA = _mm_add_epi32(_mm256_castsi256_si128(sumA), _mm256_extracti128_si256(sumA, 1));
+		__m128i lanesB = _mm_add_epi32(_mm256_castsi256_si128(sumB), _mm256_extracti128_si256(sumB, 1));
+		a = (a + HorizontalSum(lanesA)) % ADLER_BASE;
+		b = HorizontalSum(lanesB) % ADLER_BASE;
+	}
+	return Adler32Scalar((b << 16) | a, data, size);
+}
+#endif
+
+typedef uint32_t(*Adler32Function)(uint32_t adler, const byte_t *data, size_t size);
+
+static Adler32Function SelectAdler32Function()
+{
+#ifdef PNG_X86
+	switch (GetInstructionSet())
+	{
+	case InstructionSet::AVX2:
+		return Adler32AVX2;
+	case InstructionSet::SSE41:
+		return Adler32SSSE3;
+	default:
+		break;
+	}
+#endif
+	return Adler32Scalar;
+}
+
+uint32_t UpdateAdler32(const uint32_t & adler, const byte_t * data, const size_t & size)
+{
+	static const Adler32Function function = SelectAdler32Function();
+	return function(adler, data, size);
+}
+
+uint32_t UpdateAdler32Scalar(const uint32_t & adler, const byte_t * data, const size_t & size)
+{
+	return Adler32Scalar(adler, data, size);
+}
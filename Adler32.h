@@ -0,0 +1,10 @@
+#pragma once
+#include <Binary.h>
+
+// Updates a running Adler-32(the checksum at the end of a zlib stream) with "size" bytes. Start with 1, the
+// result of one call can be passed to the next one to continue the calculation. The kernel is selected
+// once from the CPU features(AVX2, SSSE3 or scalar), all of them reduce the sums modulo 65521 only once
+// every few thousand bytes.
+uint32_t UpdateAdler32(const uint32_t &adler, const byte_t *data, const size_t &size);
+// Same as above, but always uses the scalar code
+uint32_t UpdateAdler32Scalar(const uint32_t &adler, const byte_t *data, const size_t &size);
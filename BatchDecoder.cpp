@@ -0,0 +1,51 @@
+#include "BatchDecoder.h"
+
+BatchDecoder::BatchDecoder(const size_t & threads)
+	: m_oPool(threads), m_pContexts(new WorkerContext[m_oPool.Size()])
+{}
+
+BatchDecoder::~BatchDecoder()
+{
+}
+
+std::vector<BatchResult> BatchDecoder::Decode(const std::vector<std::string>& files, const ImageCallback & callback)
+{
+	std::vector<BatchResult> results(files.size());
+	m_oPool.Run(files.size(), [&](const size_t &worker, const size_t &index) {
+		WorkerContext &context = m_pContexts[worker];
+		BatchResult &result = results[index];
+		DecodeFile(context, files[index], result);
+		if (result.error.empty() && callback)
+			callback(index, result, context.image);
+	});
+	return results;
+}
+
+void BatchDecoder::DecodeFile(WorkerContext & context, const std::string & path, BatchResult & result)
+{
+	result.path = path;
+	result.width = 0;
+	result.height = 0;
+	result.inputSize = 0;
+	result.dataSize = 0;
+	try {
+		if (!context.decoder.DecodeFile(path, context.image)) {
+			const char *error = context.decoder.GetError();
+			result.error = (error != nullptr) ? error : "Couldn't decode the file!";
+			return;
+		}
+	}
+	catch (const char *error) {
+		result.error = error;
+		return;
+	}
+	catch (const std::exception &exception) {
+		result.error = exception.what();
+		return;
+	}
+
+	result.width = context.image.Width();
+	result.height = context.image.Height();
+	result.inputSize = context.decoder.GetInputSize();
+	result.dataSize = context.decoder.GetDataSize();
+}
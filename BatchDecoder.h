@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "Decoder.h"
+#include "ThreadPool.h"
+
+// Outcome of decoding a single file of a batch
+struct BatchResult {
+	std::string path;
+	std::string error; // Empty if the file was decoded
+	uint32_t width;
+	uint32_t height;
+	size_t inputSize; // Size of the file
+	size_t dataSize; // Size of the decompressed image data
+};
+
+// Receives every decoded image on the worker thread that decoded it, the image is valid only during the call
+typedef std::function<void(const size_t &index, const BatchResult &result, const Image &image)> ImageCallback;
+
+
+// Decodes many files concurrently on a work-stealing thread pool. Every worker keeps its own Decoder
+// and Image for all the files it decodes, so they are not allocated again for each file.
+class BatchDecoder
+{
+public:
+	// 0 threads means one per hardware thread
+	BatchDecoder(const size_t &threads = 0);
+	~BatchDecoder();
+
+	size_t Threads() const { return m_oPool.Size(); }
+	// The results are in the same order as the files. The callback(if any) is called for each decoded image
+	std::vector<BatchResult> Decode(const std::vector<std::string> &files, const ImageCallback &callback = nullptr);
+
+private: // Types
+	struct WorkerContext {
+		Decoder decoder;
+		Image image;
+	};
+
+private: // Methods
+	void DecodeFile(WorkerContext &context, const std::string &path, BatchResult &result);
+
+private: // Variables
+	ThreadPool m_oPool;
+	std::unique_ptr<WorkerContext[]> m_pContexts;
+};
@@ -0,0 +1,122 @@
+// Command line batch decoder
+// Usage: PNGBatch [-j threads] [-q] <file | directory | @list>...
+//   directory - every .png file in the directory(not recursive)
+//   @list     - a text file with one path per line
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "BatchDecoder.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static bool IsDirectory(const std::string &path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+static bool HasPNGExtension(const std::string &name)
+{
+	if (name.size() < 4)
+		return false;
+	std::string extension = name.substr(name.size() - 4);
+	for (char &c : extension)
+		c = (char)tolower(c);
+	return extension == ".png";
+}
+
+static void ListDirectory(const std::string &directory, std::vector<std::string> &files)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*.png").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do {
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			files.push_back(directory + "\\" + data.cFileName);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR *dir = opendir(directory.c_str());
+	if (dir == nullptr)
+		return;
+	while (dirent *entry = readdir(dir)) {
+		std::string path = directory + "/" + entry->d_name;
+		if (HasPNGExtension(entry->d_name) && !IsDirectory(path))
+			files.push_back(path);
+	}
+	closedir(dir);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	size_t threads = 0;
+	bool quiet = false;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = (size_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "-q") == 0) {
+			quiet = true; // Only the summary
+		}
+		else if (argv[i][0] == '@') {
+			std::ifstream list(argv[i] + 1);
+			std::string line;
+			while (std::getline(list, line)) {
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty())
+					files.push_back(line);
+			}
+		}
+		else if (IsDirectory(argv[i])) {
+			ListDirectory(argv[i], files);
+		}
+		else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [-j threads] [-q] <file | directory | @list>...\n";
+		return 1;
+	}
+
+	BatchDecoder decoder(threads);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<BatchResult> results = decoder.Decode(files);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t failed = 0;
+	size_t inputBytes = 0;
+	for (const BatchResult &result : results) {
+		inputBytes += result.inputSize;
+		if (!result.error.empty())
+			failed++;
+		if (quiet)
+			continue;
+		if (result.error.empty())
+			std::cout << result.path << ": " << result.width << "x" << result.height << "\n";
+		else
+			std::cout << result.path << ": error: " << result.error << "\n";
+	}
+
+	std::cout << results.size() << " files, " << failed << " failed, " << decoder.Threads() << " threads, " << seconds << " s\n";
+	if (seconds > 0) {
+		std::cout << results.size() / seconds << " files/s, " << inputBytes / seconds / (1024 * 1024) << " MB/s\n";
+	}
+	return failed == 0 ? 0 : 2;
+}
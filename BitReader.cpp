@@ -0,0 +1,81 @@
+#include "BitReader.h"
+#include <algorithm> // used for std::min()
+
+BitReader::BitReader()
+	: m_pSource(nullptr), m_pData(nullptr), m_uSize(0), m_uPosition(0), m_uBuffer(0), m_uBitCount(0)
+{}
+
+BitReader::~BitReader()
+{
+}
+
+void BitReader::SetData(const byte_t * data, const size_t & size)
+{
+	m_pSource = nullptr;
+	m_pData = data;
+	m_uSize = size;
+	m_uPosition = 0;
+	m_uBuffer = 0;
+	m_uBitCount = 0;
+}
+
+void BitReader::SetSource(ByteSource * source)
+{
+	SetData(nullptr, 0);
+	m_pSource = source;
+}
+
+void BitReader::FlushBits()
+{
+	ConsumeBits(m_uBitCount % 8);
+}
+
+void BitReader::ReadData(byte_t * out, const size_t & size)
+{
+	if (m_uBitCount % 8 != 0)
+		throw "Trying to read bytes from a position that is not byte-aligned!";
+
+	// Draining the bytes that are already in the bit buffer
+	size_t read = 0;
+	while (read < size && m_uBitCount > 0) {
+		out[read++] = (byte_t)GetBits(8);
+	}
+
+	// Copying the rest directly from the segments
+	while (read < size) {
+		if (m_uPosition == m_uSize && !NextSegment())
+			throw "Unexpected end of the compressed stream!";
+		size_t count = std::min(size - read, m_uSize - m_uPosition);
+		memcpy(out + read, m_pData + m_uPosition, count);
+		m_uPosition += count;
+		read += count;
+	}
+}
+
+size_t BitReader::ReadInPlace(const byte_t *& data, const size_t & maxSize)
+{
+	if (m_uBitCount != 0)
+		throw "Trying to read bytes in place while the bit buffer is not empty!";
+	if (m_uPosition == m_uSize && !NextSegment())
+		throw "Unexpected end of the compressed stream!";
+
+	size_t count = std::min(maxSize, m_uSize - m_uPosition);
+	data = m_pData + m_uPosition;
+	m_uPosition += count;
+	return count;
+}
+
+bool BitReader::NextSegment()
+{
+	const byte_t *data;
+	size_t size;
+	while (m_pSource != nullptr && m_pSource->NextSegment(data, size)) {
+		if (size > 0) {
+			m_pData = data;
+			m_uSize = size;
+			m_uPosition = 0;
+			return true;
+		}
+	}
+	return false;
+}
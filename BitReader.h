@@ -0,0 +1,119 @@
+#pragma once
+#include <Binary.h>
+#include <cstring> // used for memcpy()
+
+#define MAX_PEEK_BITS 56
+
+// Supplies a stream in parts, e.g. the compressed stream split in IDAT chunks
+class ByteSource
+{
+public:
+	virtual ~ByteSource() {}
+	// Returns false when there is no more data. Segments of size 0 are skipped
+	virtual bool NextSegment(const byte_t *&data, size_t &size) = 0;
+};
+
+// Reads a DEFLATE stream starting from the least significant bit of each byte. The bits are kept
+// in a 64-bit buffer, so they can be looked at without consuming them, which is what the table
+// driven Huffman decoding needs. The stream can be split in multiple segments, which are requested
+// from a ByteSource only when the reader reaches their beginning.
+class BitReader
+{
+public:
+	BitReader();
+	~BitReader();
+
+	void SetData(const byte_t *data, const size_t &size);
+	void SetSource(ByteSource *source);
+	// Returns the next "count"(up to MAX_PEEK_BITS) bits without consuming them. Bits past the end of the data are read as 0
+	inline uint32_t PeekBits(const uint32_t &count);
+	inline void ConsumeBits(const uint32_t &count);
+	inline uint32_t GetBits(const uint32_t &count);
+	// Fills the buffer to at least MAX_PEEK_BITS bits with a single unaligned load. Returns false
+	// (without reading anything) when less than 8 bytes are left in the current segment
+	inline bool RefillFast();
+	// Same as the methods above, but without any checks. Only valid for the bits guaranteed by RefillFast()
+	inline uint32_t PeekBitsFast(const uint32_t &count) const { return (uint32_t)(m_uBuffer & (((uint64_t)1 << count) - 1)); }
+	inline void ConsumeBitsFast(const uint32_t &count) { m_uBuffer >>= count; m_uBitCount -= count; }
+	inline uint32_t GetBitsFast(const uint32_t &count);
+	// Discards the remaining bits in the current byte
+	void FlushBits();
+	// Reads whole bytes, the reader must be byte-aligned(see FlushBits())
+	void ReadData(byte_t *out, const size_t &size);
+	// Number of whole bytes that are already loaded in the bit buffer
+	size_t BufferedBytes() const { return m_uBitCount / 8; }
+	// Gives the next bytes in place, without copying them. Returns how many(up to "maxSize") are available
+	// before the end of the current segment. The bit buffer must be empty(see BufferedBytes())
+	size_t ReadInPlace(const byte_t *&data, const size_t &maxSize);
+
+private: // Methods
+	inline void Refill();
+	// Moves to the next non-empty segment, returns false at the end of the stream
+	bool NextSegment();
+
+private: // Variables
+	ByteSource *m_pSource;
+	const byte_t *m_pData; // The current segment
+	size_t m_uSize;
+	size_t m_uPosition;
+	uint64_t m_uBuffer;
+	uint32_t m_uBitCount;
+};
+
+inline uint32_t BitReader::PeekBits(const uint32_t &count)
+{
+	if (m_uBitCount < count)
+		Refill();
+	return PeekBitsFast(count);
+}
+
+inline void BitReader::ConsumeBits(const uint32_t &count)
+{
+	if (m_uBitCount < count)
+		throw "Unexpected end of the compressed stream!";
+	ConsumeBitsFast(count);
+}
+
+inline uint32_t BitReader::GetBits(const uint32_t &count)
+{
+	uint32_t bits = PeekBits(count);
+	ConsumeBits(count);
+	return bits;
+}
+
+inline uint32_t BitReader::GetBitsFast(const uint32_t &count)
+{
+	uint32_t bits = PeekBitsFast(count);
+	ConsumeBitsFast(count);
+	return bits;
+}
+
+inline bool BitReader::RefillFast()
+{
+	if (m_uSize - m_uPosition < sizeof(uint64_t))
+		return false;
+
+	// Loading 8 bytes(assuming a little-endian CPU) and keeping as many whole bytes as fit in the buffer
+	uint64_t word;
+	memcpy(&word, m_pData + m_uPosition, sizeof(word));
+	uint32_t bytes = (63 - m_uBitCount) >> 3;
+	m_uBuffer |= word << m_uBitCount;
+	m_uPosition += bytes;
+	m_uBitCount += bytes * 8;
+	m_uBuffer &= ((uint64_t)1 << m_uBitCount) - 1; // Dropping the bytes that didn't fit
+	return true;
+}
+
+inline void BitReader::Refill()
+{
+	if (RefillFast())
+		return;
+
+	// Near the end of a segment the bytes are added one by one
+	while (m_uBitCount < MAX_PEEK_BITS) {
+		if (m_uPosition == m_uSize && !NextSegment())
+			break;
+		m_uBuffer |= (uint64_t)m_pData[m_uPosition++] << m_uBitCount;
+		m_uBitCount += 8;
+	}
+}
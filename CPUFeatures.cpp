@@ -0,0 +1,76 @@
+#include "CPUFeatures.h"
+#include <cstdint>
+
+#if defined(PNG_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(PNG_X86)
+#include <cpuid.h>
+#endif
+
+#ifdef PNG_X86
+static void CPUID(uint32_t regs[4], const uint32_t &leaf, const uint32_t &subleaf)
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t XGETBV(const uint32_t &index)
+{
+#ifdef _MSC_VER
+	return _xgetbv(index);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static CPUFeatures DetectCPUFeatures()
+{
+	CPUFeatures features = { false, false, false, false, false };
+	uint32_t regs[4]; // EAX, EBX, ECX, EDX
+	CPUID(regs, 0, 0);
+	uint32_t maxLeaf = regs[0];
+
+	CPUID(regs, 1, 0);
+	features.SSE2 = (regs[3] & (1u << 26)) != 0;
+	features.SSSE3 = (regs[2] & (1u << 9)) != 0;
+	features.SSE41 = (regs[2] & (1u << 19)) != 0;
+	features.PCLMUL = (regs[2] & (1u << 1)) != 0;
+
+	// AVX2 is usable only if the OS has enabled saving of the XMM and YMM state(OSXSAVE and XCR0 bits 1 and 2)
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	if (osxsave && maxLeaf >= 7 && (XGETBV(0) & 0x6) == 0x6) {
+		CPUID(regs, 7, 0);
+		features.AVX2 = (regs[1] & (1u << 5)) != 0;
+	}
+	return features;
+}
+#else
+static CPUFeatures DetectCPUFeatures()
+{
+	return { false, false, false, false, false };
+}
+#endif
+
+const CPUFeatures & GetCPUFeatures()
+{
+	static const CPUFeatures features = DetectCPUFeatures();
+	return features;
+}
+
+InstructionSet GetInstructionSet(const InstructionSet & limit)
+{
+	const CPUFeatures &features = GetCPUFeatures();
+	InstructionSet best = InstructionSet::SCALAR;
+	if (features.SSE2)
+		best = InstructionSet::SSE2;
+	if (best == InstructionSet::SSE2 && features.SSSE3 && features.SSE41)
+		best = InstructionSet::SSE41;
+	if (best == InstructionSet::SSE41 && features.AVX2)
+		best = InstructionSet::AVX2;
+	return ((int)best < (int)limit) ? best : limit;
+}
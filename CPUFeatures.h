@@ -0,0 +1,40 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PNG_X86 1
+#endif
+
+// MSVC lets any function use the intrinsics, while GCC and Clang need each function to be marked with its target
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#define TARGET_SSE2
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#endif
+
+
+// Instruction sets the SIMD kernels are written for, ordered from the oldest to the newest
+enum class InstructionSet {
+	SCALAR = 0,
+	SSE2 = 1,
+	SSE41 = 2, // SSSE3 and SSE4.1
+	AVX2 = 3
+};
+
+struct CPUFeatures {
+	bool SSE2;
+	bool SSSE3;
+	bool SSE41;
+	bool AVX2; // Also requires the OS to save the YMM registers
+	bool PCLMUL; // Carry-less multiplication, used by the CRC-32 kernel
+};
+
+// Detected once using cpuid
+const CPUFeatures &GetCPUFeatures();
+// Returns the newest instruction set that is available and not newer than "limit"
+InstructionSet GetInstructionSet(const InstructionSet &limit = InstructionSet::AVX2);
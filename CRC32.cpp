@@ -0,0 +1,154 @@
+#include "CRC32.h"
+#include "CPUFeatures.h"
+#include <cstring> // used for memcpy()
+
+#ifdef PNG_X86
+#include <immintrin.h>
+#endif
+
+#define CRC32_POLYNOMIAL 0xEDB88320 // Reversed 0x04C11DB7
+
+struct CRC32Tables {
+	uint32_t table[8][256];
+};
+
+// table[0] is the usual byte at a time table, table[k] gives the CRC of a byte followed by k zero bytes
+static constexpr CRC32Tables MakeCRC32Tables()
+{
+	CRC32Tables tables = {};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (uint32_t bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+		}
+		tables.table[0][i] = crc;
+	}
+	for (uint32_t k = 1; k < 8; k++) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t previous = tables.table[k - 1][i];
+			tables.table[k][i] = (previous >> 8) ^ tables.table[0][previous & 0xFF];
+		}
+	}
+	return tables;
+}
+
+static constexpr CRC32Tables Tables = MakeCRC32Tables();
+
+// Works on the inverted CRC
+static uint32_t CRC32Slice8(uint32_t crc, const byte_t *data, size_t size)
+{
+	const uint32_t(&t)[8][256] = Tables.table;
+	while (size >= 8) {
+		uint32_t low, high;
+		memcpy(&low, data, sizeof(low));
+		memcpy(&high, data + 4, sizeof(high));
+		low ^= crc;
+		crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+			t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+	while (size-- > 0) {
+		crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#ifdef PNG_X86
+// Folding constants for the reversed polynomial(x^n mod P for the fold distances, and the Barrett reduction constants)
+alignas(16) static const uint64_t FoldBy4[2] = { 0x0154442BD4, 0x01C6E41596 }; // 512 bits
+alignas(16) static const uint64_t FoldBy1[2] = { 0x01751997D0, 0x00CCAA009E }; // 128 bits
+alignas(16) static const uint64_t Fold64[2] = { 0x0163CD6124, 0 };
+alignas(16) static const uint64_t Barrett[2] = { 0x01DB710641, 0x01F7011641 };
+
+TARGET_PCLMUL static inline __m128i Fold(const __m128i &value, const __m128i &constants, const __m128i &next)
+{
+	__m128i low = _mm_clmulepi64_si128(value, constants, 0x00);
+	__m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(low, high), next);
+}
+
+// Works on the inverted CRC. "size" must be a multiple of 16 and at least 64
+TARGET_PCLMUL static uint32_t CRC32PCLMUL(uint32_t crc, const byte_t *data, size_t size)
+{
+	// Four 128-bit lanes are folded in parallel to hide the latency of the multiplication
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	data += 64;
+	size -= 64;
+
+	__m128i constants = _mm_load_si128((const __m128i*)FoldBy4);
+	while (size >= 64) {
+		x1 = Fold(x1, constants, _mm_loadu_si128((const __m128i*)(data + 0x00)));
+		x2 = Fold(x2, constants, _mm_loadu_si128((const __m128i*)(data + 0x10)));
+		x3 = Fold(x3, constants, _mm_loadu_si128((const __m128i*)(data + 0x20)));
+		x4 = Fold(x4, constants, _mm_loadu_si128((const __m128i*)(data + 0x30)));
+		data += 64;
+		size -= 64;
+	}
+
+	// Folding the lanes into one
+	constants = _mm_load_si128((const __m128i*)FoldBy1);
+	x1 = Fold(x1, constants, x2);
+	x1 = Fold(x1, constants, x3);
+	x1 = Fold(x1, constants, x4);
+	while (size >= 16) {
+		x1 = Fold(x1, constants, _mm_loadu_si128((const __m128i*)data));
+		data += 16;
+		size -= 16;
+	}
+
+	// 128 to 64 bits
+	__m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	x2 = _mm_clmulepi64_si128(x1, constants, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	constants = _mm_loadl_epi64((const __m128i*)Fold64);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), constants, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	constants = _mm_load_si128((const __m128i*)Barrett);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), constants, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), constants, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t CRC32Folding(uint32_t crc, const byte_t *data, size_t size)
+{
+	if (size >= 64) {
+		size_t blocks = size & ~(size_t)15;
+		crc = CRC32PCLMUL(crc, data, blocks);
+		data += blocks;
+		size -= blocks;
+	}
+	return CRC32Slice8(crc, data, size);
+}
+#endif
+
+typedef uint32_t(*CRC32Function)(uint32_t crc, const byte_t *data, size_t size);
+
+static CRC32Function SelectCRC32Function()
+{
+#ifdef PNG_X86
+	const CPUFeatures &features = GetCPUFeatures();
+	if (features.PCLMUL && features.SSE41)
+		return CRC32Folding;
+#endif
+	return CRC32Slice8;
+}
+
+uint32_t UpdateCRC32(const uint32_t & crc, const byte_t * data, const size_t & size)
+{
+	static const CRC32Function function = SelectCRC32Function();
+	return ~function(~crc, data, size);
+}
+
+uint32_t UpdateCRC32Scalar(const uint32_t & crc, const byte_t * data, const size_t & size)
+{
+	return ~CRC32Slice8(~crc, data, size);
+}
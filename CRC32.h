@@ -0,0 +1,9 @@
+#pragma once
+#include <Binary.h>
+
+// Updates a running CRC-32(the one used by PNG chunks and zlib) with "size" bytes. Start with 0, the
+// result of one call can be passed to the next one to continue the calculation. The kernel is selected
+// once from the CPU features: PCLMULQDQ folding if it is available, otherwise slicing-by-8 tables.
+uint32_t UpdateCRC32(const uint32_t &crc, const byte_t *data, const size_t &size);
+// Same as above, but always uses the tables
+uint32_t UpdateCRC32Scalar(const uint32_t &crc, const byte_t *data, const size_t &size);
@@ -0,0 +1,53 @@
+#include "Decoder.h"
+
+Decoder::Decoder()
+	: m_uDataSize(0), m_bPipelined(false)
+{
+	m_oPNG.SetVerbose(false);
+}
+
+Decoder::~Decoder()
+{
+}
+
+bool Decoder::Decode(const byte_t * input, const size_t & size, Image & output)
+{
+	m_oPNG.OpenMemory(input, size);
+	return DecodeInput(output);
+}
+
+bool Decoder::DecodeFile(const std::string & filepath, Image & output)
+{
+	m_oPNG.Open(filepath);
+	return DecodeInput(output);
+}
+
+bool Decoder::Probe(const byte_t * input, const size_t & size, PNGInfo & info)
+{
+	m_oPNG.OpenMemory(input, size);
+	return m_oPNG.Probe(info);
+}
+
+bool Decoder::ProbeFile(const std::string & filepath, PNGInfo & info)
+{
+	m_oPNG.Open(filepath);
+	return m_oPNG.Probe(info);
+}
+
+bool Decoder::DecodeInput(Image & output)
+{
+	if (!m_bPipelined) {
+		bool decoded = m_oPNG.Decode(m_vData, output);
+		m_uDataSize = m_vData.size();
+		return decoded;
+	}
+	bool decoded = m_oPNG.DecodePipelined(m_vData, output);
+	// The rows of images without interlacing go through the row queue instead of the buffer
+	m_uDataSize = m_oPNG.IsInterlaced() ? m_vData.size() : m_oPNG.GetDataSize();
+	return decoded;
+}
+
+void Decoder::Reset()
+{
+	m_oPNG.Close();
+}
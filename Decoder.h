@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include "PNG.h"
+
+// Reusable decoding context. The decompression window and tables, the decompressed data buffer and the
+// scratch buffers are kept from one image to the next, so after the first few images decoding an image of
+// the same or smaller size doesn't allocate memory. One Decoder should be used by one thread at a time.
+class Decoder
+{
+public:
+	Decoder();
+	~Decoder();
+
+	// Decodes a PNG datastream from memory in "output", which is resized(and reuses its buffer if it is big enough).
+	// Returns false if the data is not a valid PNG(see GetError()), a corrupted stream throws an exception
+	bool Decode(const byte_t *input, const size_t &size, Image &output);
+	// Same as above, but the file is memory-mapped while decoding
+	bool DecodeFile(const std::string &filepath, Image &output);
+	// Reads only the metadata and the chunk index, see PNG::Probe()
+	bool Probe(const byte_t *input, const size_t &size, PNGInfo &info);
+	bool ProbeFile(const std::string &filepath, PNGInfo &info);
+	// Releases the input of the last image. The buffers are kept
+	void Reset();
+	// See PNG::SetCRCPolicy()
+	void SetCRCPolicy(const CRCPolicy &policy) { m_oPNG.SetCRCPolicy(policy); }
+	// See PNG::SetOutputFormat()
+	void SetOutputFormat(const OutputFormat &format) { m_oPNG.SetOutputFormat(format); }
+	// See PNG::SetSizeLimit()
+	void SetSizeLimit(const uint64_t &bytes) { m_oPNG.SetSizeLimit(bytes); }
+	// See PNG::SetPreviewPasses() and PNG::SetThreadPool()
+	void SetPreviewPasses(const uint32_t &passes) { m_oPNG.SetPreviewPasses(passes); }
+	// The pool may be shared by the Decoders of several threads
+	void SetThreadPool(ThreadPool *pool) { m_oPNG.SetThreadPool(pool); }
+	// False by default. The filters are reversed on a second thread while the data is decompressed, see PNG::DecodePipelined().
+	// The thread is created by the first pipelined image and kept by the Decoder
+	void SetPipelined(const bool &pipelined) { m_bPipelined = pipelined; }
+	const char *GetError() const { return m_oPNG.GetError(); }
+	// Size of the last input and of its decompressed image data
+	size_t GetInputSize() const { return m_oPNG.GetInputSize(); }
+	size_t GetDataSize() const { return m_uDataSize; }
+
+private: // Methods
+	// Decodes the input opened in m_oPNG
+	bool DecodeInput(Image &output);
+
+private: // Variables
+	PNG m_oPNG;
+	binary_t m_vData; // The decompressed image data
+	size_t m_uDataSize;
+	bool m_bPipelined;
+};
@@ -0,0 +1,197 @@
+#include "HuffmanTable.h"
+#include "PNGInflator.h"
+
+// Base values and number of extra bits for the length symbols 257 - 285
+constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t LengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+// Base values and number of extra bits for the distance symbols 0 - 29
+constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t DistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static constexpr HuffmanEntry MakeEntry(const uint32_t &symbol, const uint32_t &length, const Alphabet &alphabet)
+{
+	HuffmanEntry entry = { 0, (uint8_t)length, 0, HuffmanSymbol::INVALID };
+	switch (alphabet)
+	{
+	case Alphabet::CODE_LENGTHS:
+		if (symbol < CLEN_LEN_COUNT) {
+			entry.type = HuffmanSymbol::CODE_LENGTH;
+			entry.value = (uint16_t)symbol;
+			// Symbols 16, 17 and 18 are followed by a 2, 3 and 7 bit repeat count
+			entry.extra = (symbol == 16) ? 2 : (symbol == 17) ? 3 : (symbol == 18) ? 7 : 0;
+		}
+		break;
+	case Alphabet::LITERALS:
+		if (symbol < 256) {
+			entry.type = HuffmanSymbol::LITERAL;
+			entry.value = (uint16_t)symbol;
+		}
+		else if (symbol == 256) {
+			entry.type = HuffmanSymbol::END_OF_BLOCK;
+		}
+		else if (symbol <= 285) {
+			entry.type = HuffmanSymbol::LENGTH;
+			entry.value = LengthBase[symbol - 257];
+			entry.extra = LengthExtraBits[symbol - 257];
+		}
+		break;
+	case Alphabet::DISTANCES:
+		if (symbol < 30) {
+			entry.type = HuffmanSymbol::DISTANCE;
+			entry.value = DistanceBase[symbol];
+			entry.extra = DistanceExtraBits[symbol];
+		}
+		break;
+	}
+	return entry;
+}
+
+// The codes are stored bit-reversed, because the stream is read starting from the least significant bit
+static constexpr uint32_t ReverseBits(const uint32_t &code, const uint32_t &length)
+{
+	uint32_t reversed = 0;
+	for (uint32_t i = 0; i < length; i++)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+	return reversed;
+}
+
+// Code lengths of the fixed codes(RFC 1951, 3.2.6)
+struct FixedLitLenLengths {
+	static constexpr uint32_t Get(const uint32_t &symbol) { return (symbol < 144) ? 8 : (symbol < 256) ? 9 : (symbol < 280) ? 7 : 8; }
+};
+struct FixedDistLengths {
+	static constexpr uint32_t Get(const uint32_t &) { return 5; }
+};
+
+// Builds a table with the canonical codes for the given lengths. All codes must fit in the root table
+template <uint32_t RootBits, uint32_t Count, class Lengths>
+static constexpr HuffmanEntries<(1 << RootBits)> MakeFixedTable(const Alphabet &alphabet)
+{
+	HuffmanEntries<(1 << RootBits)> table = {};
+
+	// Counting the codes of each length and finding the first code of each length
+	uint32_t lengthCount[MAX_CODE_BITS + 1] = {};
+	for (uint32_t symbol = 0; symbol < Count; symbol++)
+		lengthCount[Lengths::Get(symbol)]++;
+	uint32_t nextCode[MAX_CODE_BITS + 1] = {};
+	for (uint32_t bits = 1, code = 0; bits <= MAX_CODE_BITS; bits++) {
+		code = (code + lengthCount[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	for (uint32_t symbol = 0; symbol < Count; symbol++) {
+		uint32_t length = Lengths::Get(symbol);
+		uint32_t reversed = ReverseBits(nextCode[length]++, length);
+		for (uint32_t i = reversed; i < (1u << RootBits); i += 1u << length)
+			table.entries[i] = MakeEntry(symbol, length, alphabet);
+	}
+	return table;
+}
+
+constexpr HuffmanEntries<(1 << LITLEN_ROOT_BITS)> FixedLitLenTable = MakeFixedTable<LITLEN_ROOT_BITS, FIXED_LITLEN_COUNT, FixedLitLenLengths>(Alphabet::LITERALS);
+constexpr HuffmanEntries<(1 << DIST_ROOT_BITS)> FixedDistTable = MakeFixedTable<DIST_ROOT_BITS, FIXED_DIST_COUNT, FixedDistLengths>(Alphabet::DISTANCES);
+
+HuffmanTable::HuffmanTable(HuffmanEntry * storage, const size_t & capacity, const uint32_t & rootBits)
+	: m_pStorage(storage), m_uCapacity(capacity), m_pEntries(nullptr), m_uRootBits(rootBits)
+{}
+
+HuffmanTable::HuffmanTable(const HuffmanEntry * entries, const uint32_t & rootBits)
+	: m_pStorage(nullptr), m_uCapacity(0), m_pEntries(entries), m_uRootBits(rootBits)
+{}
+
+HuffmanTable::~HuffmanTable()
+{
+}
+
+void HuffmanTable::Build(const uint8_t * lengths, const uint32_t & count, const Alphabet & alphabet)
+{
+	m_pEntries = nullptr;
+	if (m_pStorage == nullptr)
+		throw "The Huffman table has no storage!";
+	if (count > MAX_SYMBOLS)
+		throw "Too many symbols in the Huffman code!";
+
+	// Counting the codes of each length and making sure that they fit in the code space
+	uint32_t lengthCount[MAX_CODE_BITS + 1] = {};
+	for (uint32_t symbol = 0; symbol < count; symbol++) {
+		if (lengths[symbol] > MAX_CODE_BITS)
+			throw "Huffman code length is too long!";
+		lengthCount[lengths[symbol]]++;
+	}
+	lengthCount[0] = 0;
+	int32_t left = 1; // Number of unused codes of the current length
+	for (uint32_t bits = 1; bits <= MAX_CODE_BITS; bits++) {
+		left = (left << 1) - (int32_t)lengthCount[bits];
+		if (left < 0)
+			throw "Huffman code is over-subscribed!";
+	}
+	if (left == (1 << MAX_CODE_BITS))
+		return; // No codes at all, e.g. a block that uses only literals can have no distance codes
+
+	// Sorting the symbols by code length(counting sort, the symbols of the same length stay in order),
+	// which is also the order of their canonical codes
+	uint32_t offsets[MAX_CODE_BITS + 2] = {};
+	for (uint32_t bits = 1; bits <= MAX_CODE_BITS; bits++)
+		offsets[bits + 1] = offsets[bits] + lengthCount[bits];
+	uint32_t codeCount = offsets[MAX_CODE_BITS + 1];
+	uint16_t sorted[MAX_SYMBOLS];
+	for (uint32_t symbol = 0; symbol < count; symbol++) {
+		if (lengths[symbol] != 0)
+			sorted[offsets[lengths[symbol]]++] = (uint16_t)symbol;
+	}
+
+	// Finding the first code of each length
+	uint32_t firstCode[MAX_CODE_BITS + 1] = {};
+	for (uint32_t bits = 1, code = 0; bits <= MAX_CODE_BITS; bits++) {
+		code = (code + lengthCount[bits - 1]) << 1;
+		firstCode[bits] = code;
+	}
+
+	// The codes that are longer than the root bits continue in subtables. A subtable is indexed with as
+	// many bits as its longest code needs, which is found first and kept in the root entry.
+	// Codes that are not assigned(an incomplete code) stay INVALID and are rejected while decoding.
+	const HuffmanEntry invalid = { 0, 0, 0, HuffmanSymbol::INVALID };
+	size_t rootSize = (size_t)1 << m_uRootBits;
+	std::fill(m_pStorage, m_pStorage + rootSize, invalid);
+	size_t used = rootSize;
+	uint32_t nextCode[MAX_CODE_BITS + 1];
+	memcpy(nextCode, firstCode, sizeof(nextCode));
+	for (uint32_t i = 0; i < codeCount; i++) {
+		uint32_t length = lengths[sorted[i]];
+		uint32_t reversed = ReverseBits(nextCode[length]++, length);
+		if (length > m_uRootBits) {
+			HuffmanEntry &root = m_pStorage[reversed & (rootSize - 1)];
+			root.type = HuffmanSymbol::SUBTABLE;
+			root.bits = (uint8_t)std::max<uint32_t>(root.bits, length - m_uRootBits);
+		}
+	}
+
+	memcpy(nextCode, firstCode, sizeof(nextCode));
+	for (uint32_t i = 0; i < codeCount; i++) {
+		uint32_t symbol = sorted[i];
+		uint32_t length = lengths[symbol];
+		uint32_t reversed = ReverseBits(nextCode[length]++, length);
+		HuffmanEntry entry = MakeEntry(symbol, length, alphabet);
+		if (length <= m_uRootBits) {
+			for (size_t j = reversed; j < rootSize; j += (size_t)1 << length)
+				m_pStorage[j] = entry;
+			continue;
+		}
+
+		size_t prefix = reversed & (rootSize - 1);
+		if (m_pStorage[prefix].value == 0) {
+			// First code of this subtable, the subtables are placed after the root table so offset 0 means not allocated yet
+			size_t size = (size_t)1 << m_pStorage[prefix].bits;
+			if (used + size > m_uCapacity)
+				throw "The Huffman table doesn't fit in its storage!";
+			m_pStorage[prefix].value = (uint16_t)used;
+			std::fill(m_pStorage + used, m_pStorage + used + size, invalid);
+			used += size;
+		}
+		const HuffmanEntry &root = m_pStorage[prefix];
+		size_t tableSize = (size_t)1 << root.bits;
+		for (size_t j = reversed >> m_uRootBits; j < tableSize; j += (size_t)1 << (length - m_uRootBits))
+			m_pStorage[root.value + j] = entry;
+	}
+	m_pEntries = m_pStorage; // Set at the end, so a table that failed to build stays empty
+}
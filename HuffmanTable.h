@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include "BitReader.h"
+
+#define MAX_CODE_BITS 15
+
+#define LITLEN_ROOT_BITS 10
+#define DIST_ROOT_BITS 8
+#define CLEN_ROOT_BITS 7
+
+#define FIXED_LITLEN_COUNT 288
+#define FIXED_DIST_COUNT 32
+#define MAX_SYMBOLS FIXED_LITLEN_COUNT // The largest alphabet
+#define MAX_CODE_LENGTH_BITS 7 // The code length codes are at most 7 bits long
+
+// Most entries that HuffmanTable::Build() can use for "symbols" codes of at most "maxBits" bits: the root table and, in the
+// worst case, a subtable of the largest size for every symbol
+#define HUFFMAN_TABLE_SIZE(rootBits, maxBits, symbols) (((size_t)1 << (rootBits)) + ((size_t)(symbols) << ((maxBits) - (rootBits))))
+#define LITLEN_TABLE_SIZE HUFFMAN_TABLE_SIZE(LITLEN_ROOT_BITS, MAX_CODE_BITS, FIXED_LITLEN_COUNT)
+#define DIST_TABLE_SIZE HUFFMAN_TABLE_SIZE(DIST_ROOT_BITS, MAX_CODE_BITS, FIXED_DIST_COUNT)
+#define CLEN_TABLE_SIZE HUFFMAN_TABLE_SIZE(CLEN_ROOT_BITS, MAX_CODE_LENGTH_BITS, 19)
+
+extern const uint16_t LengthBase[29];
+extern const uint8_t LengthExtraBits[29];
+extern const uint16_t DistanceBase[30];
+extern const uint8_t DistanceExtraBits[30];
+
+
+enum class Alphabet {
+	CODE_LENGTHS,
+	LITERALS, // The literal/length alphabet
+	DISTANCES
+};
+
+enum class HuffmanSymbol : uint8_t {
+	INVALID, // Unused code or a symbol that is not allowed in the alphabet
+	LITERAL,
+	END_OF_BLOCK,
+	LENGTH,
+	DISTANCE,
+	CODE_LENGTH,
+	SUBTABLE // Pointer to a secondary table for the codes longer than the root bits
+};
+
+#pragma pack(push, 1)
+struct HuffmanEntry {
+	uint16_t value; // The literal byte, code length symbol, length/distance base or the offset of the subtable
+	uint8_t bits; // Length of the code in bits. For subtables this is the number of bits used to index the subtable
+	uint8_t extra; // Number of extra bits following the code
+	HuffmanSymbol type;
+};
+#pragma pack(pop)
+
+// Wrapper that lets a constexpr function return a whole table
+template <size_t N>
+struct HuffmanEntries {
+	HuffmanEntry entries[N];
+};
+
+// Decode tables of the fixed codes used by the BTYPE=1 blocks, generated at compile time
+extern const HuffmanEntries<(1 << LITLEN_ROOT_BITS)> FixedLitLenTable;
+extern const HuffmanEntries<(1 << DIST_ROOT_BITS)> FixedDistTable;
+
+
+// Lookup table decoder for a canonical Huffman code. The primary table is indexed by the next
+// "root bits" of the stream, codes longer than that continue in secondary tables which are stored
+// after the primary one. Length and distance symbols are resolved directly to their base value.
+// The entries are written in storage owned by the caller(see PNGInflator), so building a table never allocates.
+class HuffmanTable
+{
+public:
+	// "storage" must have room for "capacity" entries, see HUFFMAN_TABLE_SIZE
+	HuffmanTable(HuffmanEntry *storage, const size_t &capacity, const uint32_t &rootBits);
+	// Uses a table that is already built(e.g. one of the fixed tables) without copying it
+	HuffmanTable(const HuffmanEntry *entries, const uint32_t &rootBits);
+	~HuffmanTable();
+
+	// Builds the table from the code length of each symbol(0 means that the symbol is not used). The codes
+	// are assigned in canonical order. An incomplete code is accepted, using one of its unassigned codes throws.
+	// If all lengths are 0 the table is empty
+	void Build(const uint8_t *lengths, const uint32_t &count, const Alphabet &alphabet);
+	bool Empty() const { return m_pEntries == nullptr; }
+	// Decodes the next symbol from the reader and consumes its code
+	inline const HuffmanEntry &Decode(BitReader &reader) const;
+	// Same as Decode(), but the caller guarantees that the reader has at least MAX_CODE_BITS bits(see BitReader::RefillFast())
+	inline const HuffmanEntry &DecodeFast(BitReader &reader) const;
+
+private: // Methods
+	inline const HuffmanEntry &Lookup(const uint32_t &bits) const;
+
+private: // Variables
+	HuffmanEntry *m_pStorage; // nullptr for the tables that are not built by the object
+	size_t m_uCapacity;
+	const HuffmanEntry *m_pEntries; // Either m_pStorage(once a table is built) or a table that is not owned by the object
+	uint32_t m_uRootBits;
+};
+
+inline const HuffmanEntry &HuffmanTable::Lookup(const uint32_t &bits) const
+{
+	const HuffmanEntry *entry = &m_pEntries[bits & ((1u << m_uRootBits) - 1)];
+	if (entry->type == HuffmanSymbol::SUBTABLE) {
+		entry = &m_pEntries[entry->value + ((bits >> m_uRootBits) & ((1u << entry->bits) - 1))];
+	}
+	if (entry->type == HuffmanSymbol::INVALID)
+		throw "Invalid Huffman code found in the stream!";
+	return *entry;
+}
+
+inline const HuffmanEntry &HuffmanTable::Decode(BitReader &reader) const
+{
+	const HuffmanEntry &entry = Lookup(reader.PeekBits(MAX_CODE_BITS));
+	reader.ConsumeBits(entry.bits);
+	return entry;
+}
+
+inline const HuffmanEntry &HuffmanTable::DecodeFast(BitReader &reader) const
+{
+	const HuffmanEntry &entry = Lookup(reader.PeekBitsFast(MAX_CODE_BITS));
+	reader.ConsumeBitsFast(entry.bits);
+	return entry;
+}
@@ -0,0 +1,69 @@
+#include "Image.h"
+#include <cstring> // used for memset()
+#include <cstdint> // used for SIZE_MAX
+
+Image::Image()
+	: m_uWidth(0), m_uHeight(0), m_stFormat{ 0, 8 }, m_uStride(0), m_uOffset(0)
+{}
+
+Image::Image(const uint32_t & width, const uint32_t & height, const size_t & pixelSize)
+	: Image()
+{
+	Resize(width, height, pixelSize);
+}
+
+Image::Image(const uint32_t & width, const uint32_t & height, const SampleFormat & format)
+	: Image()
+{
+	Resize(width, height, format);
+}
+
+Image::~Image()
+{
+}
+
+void Image::Resize(const uint32_t & width, const uint32_t & height, const size_t & pixelSize)
+{
+	Resize(width, height, SampleFormat{ (uint32_t)pixelSize, 8 });
+}
+
+void Image::Resize(const uint32_t & width, const uint32_t & height, const SampleFormat & format)
+{
+	// The sizes are checked before they are calculated, so they can't wrap around(e.g. with a 32-bit size_t)
+	const size_t maxSize = SIZE_MAX - 3 * IMAGE_ALIGNMENT;
+	if (format.BitsPerPixel() != 0 && width > (maxSize - 7) / format.BitsPerPixel())
+		throw "The image is too large!";
+	size_t stride = (format.RowBytes(width) + IMAGE_ALIGNMENT - 1) & ~(size_t)(IMAGE_ALIGNMENT - 1);
+	if (stride != 0 && (size_t)height >= maxSize / stride)
+		throw "The image is too large!";
+
+	m_uWidth = width;
+	m_uHeight = height;
+	m_stFormat = format;
+	m_uStride = stride;
+
+	// One zeroed row before the image, the image itself and room for aligning the first row.
+	// The additional IMAGE_ALIGNMENT bytes at the end let the filters load a whole vector past the last pixel.
+	size_t size = m_uStride * ((size_t)height + 1) + 2 * IMAGE_ALIGNMENT;
+	if (m_vStorage.size() < size)
+		m_vStorage.resize(size);
+	m_vFilters.resize(height);
+
+	size_t misalignment = (size_t)m_vStorage.data() % IMAGE_ALIGNMENT;
+	m_uOffset = (misalignment ? IMAGE_ALIGNMENT - misalignment : 0) + m_uStride;
+	memset(m_vStorage.data() + m_uOffset - m_uStride, 0, m_uStride);
+}
+
+uint32_t Image::Sample(const size_t & x, const size_t & y, const uint32_t & channel) const
+{
+	size_t index = x * m_stFormat.channels + channel;
+	switch (m_stFormat.bitDepth)
+	{
+	case 1: return ReadSample<1>(Row(y), index);
+	case 2: return ReadSample<2>(Row(y), index);
+	case 4: return ReadSample<4>(Row(y), index);
+	case 8: return ReadSample<8>(Row(y), index);
+	case 16: return ReadSample<16>(Row(y), index);
+	default: throw "Unsupported bit depth!";
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <Binary.h>
+
+#define IMAGE_ALIGNMENT 32 // Enough for the widest (AVX2) loads
+
+#define FORMAT_KEY(channels, bitDepth) (((channels) << 8) | (bitDepth))
+
+
+// Layout of the pixels in a row: the number of samples per pixel and the bits per sample. Samples of 16
+// bits are stored in Network-byte-order (Big-Endian) and samples of less than 8 bits are packed starting
+// from the most significant bit of each byte, as in the PNG scanlines.
+struct SampleFormat {
+	uint32_t channels;
+	uint32_t bitDepth;
+
+	size_t BitsPerPixel() const { return (size_t)channels * bitDepth; }
+	// Bytes of a whole pixel rounded up to 1, which is the distance the filters use
+	size_t PixelSize() const { return (BitsPerPixel() < 8) ? 1 : BitsPerPixel() / 8; }
+	size_t RowBytes(const uint32_t &width) const { return ((size_t)width * BitsPerPixel() + 7) / 8; }
+};
+
+// Returns the sample with the given index(counted from the beginning of the row) of a row in the format above
+template <uint32_t BitDepth>
+inline uint32_t ReadSample(const byte_t *row, const size_t &index)
+{
+	static_assert(BitDepth == 1 || BitDepth == 2 || BitDepth == 4, "Use the specializations for whole bytes");
+	size_t bit = index * BitDepth;
+	return (row[bit / 8] >> (8 - BitDepth - bit % 8)) & ((1u << BitDepth) - 1);
+}
+
+template <>
+inline uint32_t ReadSample<8>(const byte_t *row, const size_t &index) { return row[index]; }
+
+template <>
+inline uint32_t ReadSample<16>(const byte_t *row, const size_t &index) { return ((uint32_t)row[2 * index] << 8) | row[2 * index + 1]; }
+
+// Calls visitor.Run<Channels, BitDepth>() with the sample format as template arguments, so every format gets its own
+// code without any checks of the format inside the loops. Only the combinations allowed by PNG are accepted:
+// 1 channel(grayscale or indexed) with 1, 2, 4, 8 or 16 bits and 2, 3 or 4 channels with 8 or 16 bits
+template <class Visitor>
+inline void DispatchFormat(const SampleFormat &format, Visitor &&visitor)
+{
+	switch (FORMAT_KEY(format.channels, format.bitDepth))
+	{
+	case FORMAT_KEY(1, 1): visitor.template Run<1, 1>(); break;
+	case FORMAT_KEY(1, 2): visitor.template Run<1, 2>(); break;
+	case FORMAT_KEY(1, 4): visitor.template Run<1, 4>(); break;
+	case FORMAT_KEY(1, 8): visitor.template Run<1, 8>(); break;
+	case FORMAT_KEY(1, 16): visitor.template Run<1, 16>(); break;
+	case FORMAT_KEY(2, 8): visitor.template Run<2, 8>(); break;
+	case FORMAT_KEY(2, 16): visitor.template Run<2, 16>(); break;
+	case FORMAT_KEY(3, 8): visitor.template Run<3, 8>(); break;
+	case FORMAT_KEY(3, 16): visitor.template Run<3, 16>(); break;
+	case FORMAT_KEY(4, 8): visitor.template Run<4, 8>(); break;
+	case FORMAT_KEY(4, 16): visitor.template Run<4, 16>(); break;
+	default:
+		throw "Unsupported sample format!";
+	}
+}
+
+
+// Non-owning view of a single pixel inside an Image with 8-bit samples
+struct Pixel {
+	Pixel(const byte_t *data, const size_t &size) : bytes(data), size(size) {}
+	uint8_t Red() const { return bytes[0]; }
+	uint8_t Green() const { return bytes[1]; }
+	uint8_t Blue() const { return bytes[2]; }
+	uint8_t Alpha() const { return (size == 4) ? bytes[3] : UINT8_MAX; }
+	uint32_t ToInteger() const {
+		uint32_t value = 0;
+		for (size_t i = 0; i < size; i++)
+			value = (value << 8) | bytes[i];
+		return value;
+	}
+	const byte_t *bytes;
+	size_t size;
+};
+
+
+// Image stored in one contiguous buffer. Every row starts at an IMAGE_ALIGNMENT aligned address
+// and rows are "stride" bytes apart. The filter type of each row is kept in a separate vector.
+// An extra zeroed row is kept before the first one, so the filters never have to check for y == 0.
+class Image
+{
+public:
+	Image();
+	Image(const uint32_t &width, const uint32_t &height, const size_t &pixelSize);
+	Image(const uint32_t &width, const uint32_t &height, const SampleFormat &format);
+	Image(const Image &) = delete;
+	Image(Image &&) = default;
+	~Image();
+
+	Image &operator = (const Image &) = delete;
+	Image &operator = (Image &&) = default;
+
+	// Reuses the current buffer if it is big enough. The first version is for 8-bit samples
+	void Resize(const uint32_t &width, const uint32_t &height, const size_t &pixelSize);
+	void Resize(const uint32_t &width, const uint32_t &height, const SampleFormat &format);
+	uint32_t Width() const { return m_uWidth; }
+	uint32_t Height() const { return m_uHeight; }
+	const SampleFormat &Format() const { return m_stFormat; }
+	// Bytes of a whole pixel, 1 for formats with less than 8 bits per pixel
+	size_t PixelSize() const { return m_stFormat.PixelSize(); }
+	size_t RowBytes() const { return m_stFormat.RowBytes(m_uWidth); }
+	size_t Stride() const { return m_uStride; }
+	bool Empty() const { return m_uWidth == 0 || m_uHeight == 0; }
+
+	byte_t *Row(const size_t &y) { return m_vStorage.data() + m_uOffset + y * m_uStride; }
+	const byte_t *Row(const size_t &y) const { return m_vStorage.data() + m_uOffset + y * m_uStride; }
+	// Returns the row above "y", which is a row of zeros for the first row
+	const byte_t *PreviousRow(const size_t &y) const { return Row(y) - m_uStride; }
+	// Only for 8-bit samples
+	Pixel PixelAt(const size_t &x, const size_t &y) const { return Pixel(Row(y) + x * PixelSize(), PixelSize()); }
+	// Works with every format, but checks it on each call. Use DispatchFormat() and ReadSample() in loops
+	uint32_t Sample(const size_t &x, const size_t &y, const uint32_t &channel) const;
+	byte_t &Filter(const size_t &y) { return m_vFilters[y]; }
+	byte_t Filter(const size_t &y) const { return m_vFilters[y]; }
+
+private: // Variables
+	uint32_t m_uWidth;
+	uint32_t m_uHeight;
+	SampleFormat m_stFormat;
+	size_t m_uStride;
+	size_t m_uOffset; // Offset of the first row in m_vStorage
+	binary_t m_vStorage;
+	binary_t m_vFilters;
+};
@@ -0,0 +1,99 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_pData(nullptr), m_uSize(0)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char * filepath)
+{
+	Close();
+	m_hFile = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr) {
+		Close();
+		return false;
+	}
+
+	m_pData = (const byte_t*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_pData == nullptr) {
+		Close();
+		return false;
+	}
+	m_uSize = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData != nullptr)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_pData = nullptr;
+	m_uSize = 0;
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::Open(const char * filepath)
+{
+	Close();
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_pData = (const byte_t*)data;
+	m_uSize = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData != nullptr)
+		munmap((void*)m_pData, m_uSize);
+	m_pData = nullptr;
+	m_uSize = 0;
+}
+#endif
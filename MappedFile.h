@@ -0,0 +1,28 @@
+#pragma once
+#include <Binary.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	~MappedFile();
+
+	MappedFile &operator = (const MappedFile &) = delete;
+
+	// Returns false if the file couldn't be opened or mapped
+	bool Open(const char *filepath);
+	void Close();
+	const byte_t *Data() const { return m_pData; }
+	size_t Size() const { return m_uSize; }
+	bool IsOpen() const { return m_pData != nullptr; }
+
+private: // Variables
+	const byte_t *m_pData;
+	size_t m_uSize;
+#ifdef _WIN32
+	void *m_hFile;
+	void *m_hMapping;
+#endif
+};
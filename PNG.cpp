@@ -1,89 +1,384 @@
 #include "PNG.h"
 #include <iomanip>
+#include <algorithm> // used for std::min() and std::max()
 
-// The PNG signature in Network-byte-order (Big-Endian)
-uint32_t PNG_Signature[2] = { 0x474E5089, 0x0A1A0A0D };
+const byte_t PNG_Signature[PNG_SIGNATURE_SIZE] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
 
 //typedef Pixel(PNG::* FilterFunction)(const std::vector<Scanline>&, const size_t&, const size_t&);
 
 PNG::~PNG()
 {
-	delete[] m_sFilePath;
 }
 
 void PNG::Open(const char * filepath, const size_t &size)
 {
-	m_sFilePath = new char[size];
-	strcpy_s(m_sFilePath, size, filepath);
+	// Reuses the memory of the previous path when it is long enough
+	m_sFilePath.assign(filepath, strnlen(filepath, size));
+}
+
+void PNG::OpenMemory(const byte_t * data, const size_t & size)
+{
+	m_sFilePath.clear();
+	m_oFile.Close();
+	m_pInput = data;
+	m_uInputSize = size;
+}
+
+void PNG::Close()
+{
+	m_sFilePath.clear();
+	m_oFile.Close();
+	m_pInput = nullptr;
+	m_uInputSize = 0;
+	m_uPosition = 0;
+	m_sError = nullptr;
 }
 
 void PNG::ReadFile()
 {
-	std::cout << "Reading file: " << m_sFilePath << std::endl;
-	std::ifstream file(m_sFilePath, std::ios::binary);
+	binary_t decompressedData;
+	ReadFile(decompressedData);
+}
 
-	// Checking file signature
-	uint32_t sig[2];
-	file.read((char*)&sig, sizeof(sig));
-	if (!CheckSignature(sig)) {
-		std::cerr << "File signature mismatch!\n";
+void PNG::ReadFile(binary_t & buffer)
+{
+	if (!Decode(buffer))
 		return;
+	std::cout << "\nRaw pixel data:\n";
+	PrintHexPixels(m_oImage, std::cout);
+}
+
+bool PNG::Decode(binary_t & buffer)
+{
+	return Decode(buffer, m_oImage);
+}
+
+bool PNG::Decode(binary_t & buffer, Image & image)
+{
+	if (!ReadChunks())
+		return false;
+	if (IsInterlaced())
+		return DecodeInterlaced(buffer, image);
+
+	// The size of the decompressed data is known from the headers, so it is decompressed directly in the buffer
+	buffer.resize(GetDataSize());
+	m_oInflator.SetVerbose(m_bVerbose);
+	IDATSource source(*this);
+	m_oInflator.Decompress(source, buffer.data(), buffer.size());
+	if (!ReadRemainingChunks())
+		return false;
+
+	if (IsConverted()) {
+		ConvertRows(buffer, image);
+		return true;
 	}
+	ReadScanlines(buffer, image);
+	ApplyFilters(image);
+	return true;
+}
 
-	// Reading the IHDR chunk
-	Chunk IHDR = ReadChunk(file);
+void PNG::ReadRows(const RowCallback & callback)
+{
+	if (!ReadChunks())
+		return;
+	if (IsInterlaced()) {
+		binary_t buffer;
+		if (!DecodeInterlaced(buffer, m_oImage))
+			return;
+		for (uint32_t y = 0; y < m_oImage.Height(); y++)
+			callback(y, m_oImage.Row(y), m_oImage.RowBytes());
+		return;
+	}
+
+	// Indexed rows are converted to colors(and other rows to the output format) before they are passed to the callback
+	RowCallback rowCallback = callback;
+	binary_t converted;
+	if (IsConverted()) {
+		converted.resize(GetImageFormat().RowBytes(m_stHeaders.width));
+		rowCallback = [this, &converted, &callback](const uint32_t &y, const byte_t *row, const size_t &) {
+			ConvertSamples(row, converted.data());
+			callback(y, converted.data(), converted.size());
+		};
+	}
+
+	// The inflator passes the data in parts to the scanline reader, which calls the callback for every finished row
+	ScanlineReader reader(m_stHeaders.width, m_stHeaders.height, GetSampleFormat(), rowCallback);
+	m_oInflator.SetVerbose(m_bVerbose);
+	IDATSource source(*this);
+	m_oInflator.Decompress(source, [&reader](const byte_t *data, const size_t &size) {
+		reader.Write(data, size);
+	});
+	if (!ReadRemainingChunks())
+		return;
+	if (!reader.Finished())
+		throw "The decompressed stream ended before the last scanline!";
+}
 
-	if (GetChunkType(IHDR.header) != ChunkType::IHDR) {
-		std::cerr << "IHDR chunk not found!\n";
+void PNG::ReadFilePipelined()
+{
+	binary_t buffer;
+	if (!DecodePipelined(buffer, m_oImage))
 		return;
+	std::cout << "\nRaw pixel data:\n";
+	PrintHexPixels(m_oImage, std::cout);
+}
+
+bool PNG::DecodePipelined(binary_t & buffer, Image & image)
+{
+	if (!ReadChunks())
+		return false;
+	if (IsInterlaced()) {
+		// The passes can be reconstructed only after the decompression
+		return DecodeInterlaced(buffer, image);
 	}
 
+	// The calling thread decompresses the rows into the queue while the unfilter thread takes them out and reverses their filters
+	image.Resize(m_stHeaders.width, m_stHeaders.height, GetImageFormat());
+	if (IsConverted())
+		BeginConvertedRows();
+	m_oRowQueue.Reset(image.Height(), GetSampleFormat().RowBytes(m_stHeaders.width));
+	const WorkerJob job = [this, &image]() {
+		UnfilterRows(m_oRowQueue, image);
+	};
+	m_oUnfilterThread.Start(job);
+	try {
+		m_oInflator.SetVerbose(m_bVerbose);
+		IDATSource source(*this);
+		m_oInflator.Decompress(source, [this](const byte_t *data, const size_t &size) {
+			m_oRowQueue.Write(data, size);
+		});
+		m_oRowQueue.Close();
+	}
+	catch (...) {
+		m_oRowQueue.Abort();
+		// An error of the unfilter thread is thrown instead, the decompression stopped because of it
+		m_oUnfilterThread.Wait();
+		throw;
+	}
+	m_oUnfilterThread.Wait();
+	if (!m_oRowQueue.Finished())
+		throw "The decompressed stream ended before the last scanline!";
+	return ReadRemainingChunks();
+}
+
+bool PNG::ReadHeaderChunk(Chunk &IHDR)
+{
+	m_sError = nullptr;
+	if (!m_sFilePath.empty()) {
+		if (m_bVerbose)
+			std::cout << "Reading file: " << m_sFilePath << std::endl;
+		if (!m_oFile.Open(m_sFilePath.c_str()))
+			return Fail("Couldn't open the file!");
+		m_pInput = m_oFile.Data();
+		m_uInputSize = m_oFile.Size();
+	}
+
+	// Checking file signature
+	if (m_uInputSize < PNG_SIGNATURE_SIZE || !CheckSignature(m_pInput))
+		return Fail("File signature mismatch!");
+	m_uPosition = PNG_SIGNATURE_SIZE;
+
+	// Reading the IHDR chunk
+	IHDR = ReadChunk();
+
+	if (GetChunkType(IHDR.header) != ChunkType::IHDR)
+		return Fail("IHDR chunk not found!");
+
 	ParseHeaders(IHDR);
+	// The specification allows 1 to 2^31 - 1 pixels in both directions
+	if (m_stHeaders.width == 0 || m_stHeaders.height == 0 || m_stHeaders.width > (uint32_t)INT32_MAX ||
+		m_stHeaders.height > (uint32_t)INT32_MAX)
+		return Fail("Invalid image size!");
+	return true;
+}
+
+bool PNG::ReadChunks()
+{
+	Chunk IHDR;
+	if (!ReadHeaderChunk(IHDR))
+		return false;
+
 	// ToDo: The next 2 rows are for debugging purposes and I might want to remove them in future
-	PrintHeaderInfo(std::cout);
-	std::cout << std::endl;
+	if (m_bVerbose) {
+		PrintHeaderInfo(std::cout);
+		std::cout << std::endl;
+	}
+	if (!IsSupported())
+		return Fail("Unsupported image format!");
+	if (!IsWithinSizeLimit())
+		return Fail("The image is larger than the size limit!");
 
-	// Reading the IDAT chunk(s)
-	std::vector<Chunk> IDATChunks;
+	// Skipping the chunks before the image data, only the palette of indexed images is needed from them
+	m_oPalette.Reset();
 	Chunk chunk;
-	bool dataFinished = false;
 	do {
-		chunk = ReadChunk(file);
-		if (GetChunkType(chunk) == ChunkType::IDAT) {
-			if (dataFinished) {
-				std::cerr << "IDAT Chunks are not consecutive!\n";
-				return;
-			}
-			IDATChunks.push_back(chunk);
-		}
-		else if (IDATChunks.size() > 0 && !dataFinished) {
-			dataFinished = true;
-		}
-	} while (GetChunkType(chunk) != ChunkType::IEND);
+		chunk = ReadChunk();
+		if (GetChunkType(chunk) == ChunkType::IEND)
+			return Fail("IDAT chunk not found!");
+		if (!CheckUnknownChunk(chunk))
+			return false;
+		if (IsIndexed() && GetChunkType(chunk) == ChunkType::PLTE)
+			m_oPalette.SetColors(chunk.data, chunk.header.dataLength);
+		else if (IsIndexed() && GetChunkType(chunk) == ChunkType::tRNS)
+			m_oPalette.SetAlpha(chunk.data, chunk.header.dataLength);
+	} while (GetChunkType(chunk) != ChunkType::IDAT);
+	if (IsIndexed() && m_oPalette.Empty())
+		return Fail("PLTE chunk not found!");
+	PrepareOutput();
+
+	// The rest of the IDAT chunks are read while decompressing
+	m_stIDAT = chunk;
+	m_bFirstIDATPending = true;
+	m_bDataFinished = false;
+	return true;
+}
 
-	m_stIDAT = MergeDataChunks(IDATChunks);
+bool PNG::Probe(PNGInfo & info)
+{
+	info.chunks.clear();
+	info.texts.clear();
+	info.hasPHYs = false;
+	info.hasTIME = false;
 
-	// ToDo: The code below is not part of the "file reading" so it might as well be in a separate method
-	PNGInflator inf;
-	Binary decompressedData = inf.Decompress(m_stIDAT.data);
-	if (decompressedData.GetSize() == 0) {
-		std::cout << "Couldn't decompress the stream!\n";
-		return;
+	Chunk chunk;
+	if (!ReadHeaderChunk(chunk))
+		return false;
+	info.header = m_stHeaders;
+
+	// ReadChunk() only reads the header and the CRC of each chunk, the data is left in the file(which is
+	// memory-mapped, so the pages with the image data are never touched). For the same reason the CRC
+	// of the IDAT chunks is not checked
+	ProbeChunk(chunk, info);
+	while (GetChunkType(chunk) != ChunkType::IEND) {
+		chunk = ReadChunk(false);
+		if (GetChunkType(chunk) != ChunkType::IDAT)
+			VerifyCRC(chunk);
+		if (!CheckUnknownChunk(chunk))
+			return false;
+		ProbeChunk(chunk, info);
 	}
+	return true;
+}
 
-	auto slv = ReadScanlines(decompressedData);
-	ApplyFilters(slv);
-	std::cout << "\nRaw pixel data:\n";
-	PrintHexPixels(slv, std::cout);
+void PNG::ProbeChunk(const Chunk & chunk, PNGInfo & info)
+{
+	ChunkInfo entry;
+	entry.type = GetChunkType(chunk);
+	memcpy(entry.name, chunk.header.type, sizeof(entry.name));
+	entry.offset = chunk.data - m_pInput;
+	entry.length = chunk.header.dataLength;
+	info.chunks.push_back(entry);
+
+	switch (entry.type)
+	{
+	case ChunkType::pHYs:
+		if (chunk.header.dataLength < sizeof(PHYsData))
+			break;
+		memcpy(&info.pHYs, chunk.data, sizeof(PHYsData));
+		info.pHYs.pixelsPerUnitX = Binary::ByteSwap(info.pHYs.pixelsPerUnitX);
+		info.pHYs.pixelsPerUnitY = Binary::ByteSwap(info.pHYs.pixelsPerUnitY);
+		info.hasPHYs = true;
+		break;
+	case ChunkType::tIME:
+		if (chunk.header.dataLength < sizeof(TIMEData))
+			break;
+		memcpy(&info.tIME, chunk.data, sizeof(TIMEData));
+		info.tIME.year = Binary::ByteSwap(info.tIME.year);
+		info.hasTIME = true;
+		break;
+	case ChunkType::tEXt: {
+		// The keyword is separated from the text by a null byte
+		const char *text = (const char*)chunk.data;
+		const char *separator = (const char*)memchr(text, 0, chunk.header.dataLength);
+		if (separator == nullptr)
+			break;
+		info.texts.push_back({ std::string(text, separator), std::string(separator + 1, text + chunk.header.dataLength) });
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+bool PNG::Fail(const char * error)
+{
+	m_sError = error;
+	if (m_bVerbose)
+		std::cerr << error << std::endl;
+	return false;
+}
+
+bool PNG::NextDataChunk(Chunk & chunk)
+{
+	if (m_bFirstIDATPending) {
+		chunk = m_stIDAT;
+		m_bFirstIDATPending = false;
+		return true;
+	}
+	if (m_bDataFinished)
+		return false;
+
+	chunk = ReadChunk();
+	if (GetChunkType(chunk) == ChunkType::IDAT)
+		return true;
+	m_stDataEnd = chunk;
+	m_bDataFinished = true;
+	return false;
+}
+
+bool PNG::ReadRemainingChunks()
+{
+	// The inflator doesn't need to reach the end of the last IDAT chunk
+	Chunk chunk;
+	while (NextDataChunk(chunk)) {}
+
+	chunk = m_stDataEnd;
+	while (GetChunkType(chunk) != ChunkType::IEND) {
+		chunk = ReadChunk();
+		if (GetChunkType(chunk) == ChunkType::IDAT)
+			return Fail("IDAT Chunks are not consecutive!");
+		if (!CheckUnknownChunk(chunk))
+			return false;
+	}
+	return true;
+}
+
+bool IDATSource::NextSegment(const byte_t *& data, size_t & size)
+{
+	Chunk chunk;
+	if (!m_oPNG.NextDataChunk(chunk))
+		return false;
+	data = chunk.data;
+	size = chunk.header.dataLength;
+	return true;
 }
 
 bool PNG::IsSupported()
 {
-	return ((m_stHeaders.colorType == (uint8_t)ColorType::TRUECOLORA ||
-		m_stHeaders.colorType == (uint8_t)ColorType::TRUECOLOR) &&
-		m_stHeaders.bitDepth == (uint8_t)BitDepth::DEPTH8 &&
+	// Every color type and bit depth allowed by the specification
+	bool validDepth;
+	switch ((ColorType)m_stHeaders.colorType)
+	{
+	case ColorType::GRAYSCALE:
+		validDepth = m_stHeaders.bitDepth == 1 || m_stHeaders.bitDepth == 2 || m_stHeaders.bitDepth == 4 ||
+			m_stHeaders.bitDepth == 8 || m_stHeaders.bitDepth == 16;
+		break;
+	case ColorType::INDEXED:
+		validDepth = m_stHeaders.bitDepth == 1 || m_stHeaders.bitDepth == 2 || m_stHeaders.bitDepth == 4 ||
+			m_stHeaders.bitDepth == 8;
+		break;
+	case ColorType::TRUECOLOR:
+	case ColorType::GRAYSCALEA:
+	case ColorType::TRUECOLORA:
+		validDepth = m_stHeaders.bitDepth == 8 || m_stHeaders.bitDepth == 16;
+		break;
+	default:
+		validDepth = false;
+		break;
+	}
+	return (validDepth &&
 		m_stHeaders.filterMethod == 0 &&
-		m_stHeaders.interlaceMethod == 0 &&
+		m_stHeaders.interlaceMethod <= 1 && // 1 is Adam7
 		m_stHeaders.compressionMethod == 0
 		);
 }
@@ -100,30 +395,44 @@ void PNG::PrintHeaderInfo(std::ostream & stream)
 	stream << "Compression method: " << (m_stHeaders.compressionMethod ? "Unknown" : "LZ77 DEFLATE Algorithm") << std::endl;
 }
 
-void PNG::PrintHexPixels(const std::vector<Scanline>& scanlines, std::ostream &stream)
+// Prints the pixels of an image with the given format, see PNG::PrintHexPixels()
+struct HexPixelPrinter {
+	const Image &image;
+	std::ostream &stream;
+
+	template <uint32_t Channels, uint32_t BitDepth>
+	void Run() {
+		const int digits = (BitDepth + 3) / 4;
+		for (size_t y = 0; y < image.Height(); y++) {
+			const byte_t *row = image.Row(y);
+			for (size_t x = 0; x < image.Width(); x++) {
+				stream << "#";
+				for (uint32_t c = 0; c < Channels; c++)
+					stream << std::setw(digits) << ReadSample<BitDepth>(row, x * Channels + c);
+				stream << ((x == image.Width() - 1) ? "\n" : ", ");
+			}
+		}
+	}
+};
+
+void PNG::PrintHexPixels(const Image &image, std::ostream &stream)
 {
-	if (scanlines.empty() || scanlines.begin()->pixels.empty())
+	if (image.Empty())
 		return;
 	
 	std::ios_base::fmtflags flags(stream.flags()); // Save the current flags
-
-	size_t paddingSize = scanlines.begin()->pixels.begin()->bytes.size() * 2;
 	stream << std::hex << std::uppercase << std::setfill('0'); // Alter the stream flags
 
-	for (size_t i = 0; i < scanlines.size(); i++) {
-		for (size_t j = 0; j < scanlines.at(i).pixels.size(); j++) {
-			// Print the color in hex format e.g. opaque blue in RGBA is represented as bytes[4] = {0, 255, 0, 255}
-			// by the struct Pixel and after the formating is displayed in hex as #00FF00FF
-			stream << "#" << std::setw(paddingSize) << scanlines[i].pixels[j].ToInteger() << ((j == scanlines[i].pixels.size() - 1) ? "\n" : ", ");
-		}
-	}
+	// Print the samples of each pixel in hex format e.g. opaque blue in RGBA is represented as bytes[4] = {0, 255, 0, 255}
+	// and after the formating is displayed in hex as #00FF00FF. 16-bit samples have 4 digits and the ones below 8 bits 1 digit
+	DispatchFormat(image.Format(), HexPixelPrinter{ image, stream });
 
 	stream.flags(flags); // Restore the initial flags
 }
 
-bool PNG::CheckSignature(const uint32_t bytes[2])
+bool PNG::CheckSignature(const byte_t * bytes)
 {
-	return ((PNG_Signature[0] & bytes[0]) && (PNG_Signature[1] & bytes[1]));
+	return memcmp(bytes, PNG_Signature, PNG_SIGNATURE_SIZE) == 0;
 }
 
 ChunkType PNG::GetChunkType(const Chunk & chunk)
@@ -133,97 +442,130 @@ ChunkType PNG::GetChunkType(const Chunk & chunk)
 
 ChunkType PNG::GetChunkType(const ChunkHeader & header)
 {
-	if (strncmp(header.type, "IHDR", 4) == 0) {
-		return ChunkType::IHDR;
-	}
-	else if (strncmp(header.type, "PLTE", 4) == 0) {
-		return ChunkType::PLTE;
-	}
-	else if (strncmp(header.type, "IDAT", 4) == 0) {
-		return ChunkType::IDAT;
-	}
-	else if (strncmp(header.type, "IEND", 4) == 0) {
-		return ChunkType::IEND;
-	}
-	else if (strncmp(header.type, "tRNS", 4) == 0) {
-		return ChunkType::tRNS;
-	}
-	else if (strncmp(header.type, "cHRM", 4) == 0) {
-		return ChunkType::cHRM;
-	}
-	else if (strncmp(header.type, "gAMA", 4) == 0) {
-		return ChunkType::gAMA;
-	}
-	else if (strncmp(header.type, "iCCP", 4) == 0) {
-		return ChunkType::iCCP;
-	}
-	else if (strncmp(header.type, "sBIT", 4) == 0) {
-		return ChunkType::sBIT;
-	}
-	else if (strncmp(header.type, "sRGB", 4) == 0) {
-		return ChunkType::sRGB;
-	}
-	else if (strncmp(header.type, "iTXt", 4) == 0) {
-		return ChunkType::iTXt;
-	}
-	else if (strncmp(header.type, "tEXt", 4) == 0) {
-		return ChunkType::tEXt;
-	}
-	else if (strncmp(header.type, "zTXt", 4) == 0) {
-		return ChunkType::zTXt;
-	}
-	else if (strncmp(header.type, "bKGD", 4) == 0) {
-		return ChunkType::bKGD;
-	}
-	else if (strncmp(header.type, "hIST", 4) == 0) {
-		return ChunkType::hIST;
-	}
-	else if (strncmp(header.type, "pHYs", 4) == 0) {
-		return ChunkType::pHYs;
-	}
-	else if (strncmp(header.type, "sPLT", 4) == 0) {
-		return ChunkType::sPLT;
+	switch (header.Code())
+	{
+	case ChunkCode("IHDR"): return ChunkType::IHDR;
+	case ChunkCode("PLTE"): return ChunkType::PLTE;
+	case ChunkCode("IDAT"): return ChunkType::IDAT;
+	case ChunkCode("IEND"): return ChunkType::IEND;
+	case ChunkCode("tRNS"): return ChunkType::tRNS;
+	case ChunkCode("cHRM"): return ChunkType::cHRM;
+	case ChunkCode("gAMA"): return ChunkType::gAMA;
+	case ChunkCode("iCCP"): return ChunkType::iCCP;
+	case ChunkCode("sBIT"): return ChunkType::sBIT;
+	case ChunkCode("sRGB"): return ChunkType::sRGB;
+	case ChunkCode("iTXt"): return ChunkType::iTXt;
+	case ChunkCode("tEXt"): return ChunkType::tEXt;
+	case ChunkCode("zTXt"): return ChunkType::zTXt;
+	case ChunkCode("bKGD"): return ChunkType::bKGD;
+	case ChunkCode("hIST"): return ChunkType::hIST;
+	case ChunkCode("pHYs"): return ChunkType::pHYs;
+	case ChunkCode("sPLT"): return ChunkType::sPLT;
+	case ChunkCode("tIME"): return ChunkType::tIME;
+	default: return ChunkType::UNKNOWN;
 	}
-	else if (strncmp(header.type, "tIME", 4) == 0) {
-		return ChunkType::tIME;
+}
+
+bool PNG::CheckUnknownChunk(const Chunk & chunk)
+{
+	if (GetChunkType(chunk) != ChunkType::UNKNOWN)
+		return true;
+	if (!chunk.header.IsAncillary())
+		return Fail("Unknown critical chunk found!");
+	if (m_bVerbose) {
+		std::cerr << "Unknown chunk skipped! Type: " << std::string(chunk.header.type, sizeof(chunk.header.type)) <<
+			(chunk.header.IsPrivate() ? " (private)" : "") << (chunk.header.IsSafeToCopy() ? " (safe to copy)" : "") << std::endl;
 	}
-	std::cerr << "Unknown chunk encountered! Type: " << header.type << "(" <<
-		(uint32_t)header.type[0] << ", " <<
-		(uint32_t)header.type[1] << ", " <<
-		(uint32_t)header.type[2] << ", " <<
-		(uint32_t)header.type[3] << ")" << std::endl;
-	return ChunkType::UNKNOWN;
+	return true;
 }
 
-Chunk PNG::ReadChunk(std::ifstream & file)
+Chunk PNG::ReadChunk(const bool &verify)
 {
 	Chunk chunk;
-	file.read((char*)&chunk.header, sizeof(chunk.header));
+	if (m_uInputSize - m_uPosition < sizeof(chunk.header))
+		throw "Unexpected end of file!";
+	memcpy(&chunk.header, m_pInput + m_uPosition, sizeof(chunk.header));
+	m_uPosition += sizeof(chunk.header);
 	chunk.header.dataLength = Binary::ByteSwap(chunk.header.dataLength); // Convert to Little-Endian
-	chunk.data.ReadFromStream(file, chunk.header.dataLength);
-	file.read((char*)&chunk.CRC, sizeof(chunk.CRC));
+
+	if (m_uInputSize - m_uPosition < (size_t)chunk.header.dataLength + sizeof(chunk.CRC))
+		throw "Unexpected end of file!";
+	chunk.data = m_pInput + m_uPosition;
+	m_uPosition += chunk.header.dataLength;
+	memcpy(&chunk.CRC, m_pInput + m_uPosition, sizeof(chunk.CRC));
+	m_uPosition += sizeof(chunk.CRC);
 	chunk.CRC = Binary::ByteSwap(chunk.CRC);
+
+	// The data is checked right before it is used, so the decompression reads it from the cache
+	if (verify)
+		VerifyCRC(chunk);
 	return chunk;
 }
 
+void PNG::VerifyCRC(const Chunk & chunk)
+{
+	if (m_eCRCPolicy == CRCPolicy::SKIP || (m_eCRCPolicy == CRCPolicy::VERIFY_CRITICAL && chunk.header.IsAncillary()))
+		return;
+	// The CRC covers the type and the data
+	uint32_t crc = UpdateCRC32(0, (const byte_t*)chunk.header.type, sizeof(chunk.header.type));
+	crc = UpdateCRC32(crc, chunk.data, chunk.header.dataLength);
+	if (crc != chunk.CRC)
+		throw "Chunk CRC mismatch!";
+}
+
 void PNG::ParseHeaders(Chunk &IHDR)
 {
-	IHDR.data.ReadData((byte_t*)&m_stHeaders, sizeof(m_stHeaders));
+	if (IHDR.header.dataLength < sizeof(m_stHeaders))
+		throw "IHDR chunk is too short!";
+	memcpy(&m_stHeaders, IHDR.data, sizeof(m_stHeaders));
 	m_stHeaders.width = Binary::ByteSwap(m_stHeaders.width);
 	m_stHeaders.height = Binary::ByteSwap(m_stHeaders.height);
 }
 
-Chunk PNG::MergeDataChunks(std::vector<Chunk> &IDATs)
+bool PNG::IsWithinSizeLimit()
+{
+	// The factors are below 2^38, so the products can't overflow 64 bits. The limit is below SIZE_MAX, so the sizes
+	// calculated later with size_t can't wrap around on 32-bit platforms either
+	uint64_t limit = std::min<uint64_t>(m_uSizeLimit, SIZE_MAX / 2);
+	uint64_t rows = (uint64_t)m_stHeaders.height + 1;
+	// The rows of the interlaced passes add a few filter bytes and partial bytes to each row of the image
+	uint64_t dataRow = ((uint64_t)m_stHeaders.width * GetSampleFormat().BitsPerPixel() + 7) / 8 + 8;
+	// The output format is not prepared yet, the decoded pixels have at most 64 bits(native) or 32 bits(converted)
+	uint64_t imageBits = std::max<uint64_t>(GetSampleFormat().BitsPerPixel(), 32);
+	uint64_t imageRow = ((uint64_t)m_stHeaders.width * imageBits + 7) / 8 + IMAGE_ALIGNMENT;
+	return dataRow <= limit / rows && imageRow <= limit / rows;
+}
+
+size_t PNG::GetDataSize()
 {
-	if (IDATs.size() == 1)
-		return IDATs.at(0);
-	Binary data;
-	for (size_t i = 0; i < IDATs.size(); i++)
+	if (IsInterlaced()) {
+		size_t size = 0;
+		for (uint32_t pass = 0; pass < ADAM7_PASSES; pass++)
+			size += GetPassDataSize(pass);
+		return size;
+	}
+	return (size_t)m_stHeaders.height * (GetSampleFormat().RowBytes(m_stHeaders.width) + 1);
+}
+
+SampleFormat PNG::GetSampleFormat()
+{
+	switch ((ColorType)m_stHeaders.colorType)
 	{
-		data.AppendData(IDATs.at(i).data);
+	case ColorType::GRAYSCALE:
+	case ColorType::INDEXED:
+		return { 1, m_stHeaders.bitDepth };
+	case ColorType::GRAYSCALEA:
+		return { 2, m_stHeaders.bitDepth };
+	case ColorType::TRUECOLOR:
+		return { 3, m_stHeaders.bitDepth };
+	default:
+		return { 4, m_stHeaders.bitDepth };
 	}
+}
 
-	return { { data.GetSize(), { 'I','D','A','T' } }, data, 0 }; // ToDo: Might want to calculate CRC in future
+SampleFormat PNG::GetImageFormat()
+{
+	return IsIndexed() ? m_oPalette.GetOutputFormat() : m_oConverter.GetOutputFormat();
 }
 
 const char * PNG::GetColorTypeString(const ColorType &colorType)
@@ -244,88 +586,260 @@ const char * PNG::GetColorTypeString(const ColorType &colorType)
 	return nullptr;
 }
 
-std::vector<Scanline> PNG::ReadScanlines(Binary & data)
+void PNG::ReadScanlines(const binary_t & data, Image &image)
 {
-	std::cout << "Reading scanlines from stream...\n";
-	std::vector<Scanline> slv;
-	size_t pixelSize = (m_stHeaders.colorType == (uint8_t)ColorType::TRUECOLOR) ? 3 : 4;
-	Scanline sl;
-	Pixel p(pixelSize);
-	for (size_t i = 0; i < m_stHeaders.height; i++) {
-		data.ReadData((byte_t*)&sl.filter, sizeof(sl.filter));
-		for (size_t j = 0; j < m_stHeaders.width; j++) {
-			data.ReadData(p.bytes.data(), pixelSize);
-			sl.pixels.push_back(p);
-		}
-		slv.push_back(sl);
-		sl.pixels.erase(sl.pixels.begin(), sl.pixels.end());
+	if (m_bVerbose)
+		std::cout << "Reading scanlines from stream...\n";
+	image.Resize(m_stHeaders.width, m_stHeaders.height, GetSampleFormat());
+	if (data.size() < image.Height() * (image.RowBytes() + 1))
+		throw "Not enough image data!";
+	const byte_t *position = data.data();
+	for (size_t y = 0; y < image.Height(); y++) {
+		image.Filter(y) = *position++;
+		memcpy(image.Row(y), position, image.RowBytes());
+		position += image.RowBytes();
 	}
-	return slv;
 }
 
-void PNG::ApplyFilters(std::vector<Scanline>& scanlines)
+void PNG::ApplyFilters(Image &image)
 {
-	std::cout << "Applying filters to the scanlines...\n";
-	for (size_t y = 0; y < scanlines.size(); y++) {
-		switch (scanlines.at(y).filter)
-		{
-		case 0:
-			continue;
-		case 1:
-			ApplyFilterToScanline(scanlines, y, &PNG::SubFilter);
-			break;
-		case 2:
-			ApplyFilterToScanline(scanlines, y, &PNG::UpFilter);
-			break;
-		case 3:
-			ApplyFilterToScanline(scanlines, y, &PNG::AverageFilter);
-			break;
-		case 4:
-			ApplyFilterToScanline(scanlines, y, &PNG::PaethFilter);
-			break;
-		default:
-			throw "Invalid filter found!";
-			break;
-		}
+	if (m_bVerbose)
+		std::cout << "Applying filters to the scanlines...\n";
+	PNGUnfilter unfilter(image.PixelSize());
+	for (size_t y = 0; y < image.Height(); y++) {
+		unfilter.UnfilterRow(image.Filter(y), image.Row(y), image.PreviousRow(y), image.RowBytes());
 	}
 }
 
-void PNG::ApplyFilterToScanline(std::vector<Scanline>& scanlines, const size_t & lineNum, byte_t(PNG::* fn)(const std::vector<Scanline>&, const size_t&, const size_t&, const size_t&))
+void PNG::UnfilterRows(RowQueue & queue, Image & image)
 {
-	for (size_t px = 0; px < scanlines.at(lineNum).pixels.size(); px++) {
-		for (size_t byte = 0; byte < scanlines.at(lineNum).pixels.at(px).bytes.size(); byte++) {
-			// Call the function from the provided "fn" pointer(using the current context) and add it's result to the current channel
-			scanlines.at(lineNum).pixels.at(px).bytes[byte] += (this->*fn)(scanlines, px, lineNum, byte);
+	try {
+		PNGUnfilter unfilter(GetSampleFormat().PixelSize());
+		for (size_t y = 0; ; y++) {
+			const byte_t *row = queue.Front();
+			if (row == nullptr)
+				break;
+			if (IsConverted()) {
+				ConvertRow(y, row, image, unfilter);
+				queue.Pop();
+				continue;
+			}
+			image.Filter(y) = row[0];
+			memcpy(image.Row(y), row + 1, image.RowBytes());
+			queue.Pop();
+			unfilter.UnfilterRow(image.Filter(y), image.Row(y), image.PreviousRow(y), image.RowBytes());
 		}
 	}
+	catch (...) {
+		queue.Abort();
+		throw;
+	}
 }
 
-byte_t PNG::SubFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte)
+void PNG::PrepareOutput()
 {
-	return (x == 0) ? 0 : scanlines.at(y).pixels.at(x - 1).bytes.at(byte);
+	if (IsIndexed()) {
+		// Converting the 256 palette entries once is cheaper than converting every pixel
+		m_oPalette.ConvertColors(m_eOutputFormat);
+		m_oPalette.Prepare(m_stHeaders.bitDepth, m_stHeaders.width);
+		return;
+	}
+	m_oConverter.Prepare(GetSampleFormat(), m_eOutputFormat);
+}
+
+void PNG::ConvertRows(const binary_t & data, Image & image)
+{
+	if (m_bVerbose)
+		std::cout << (IsIndexed() ? "Expanding the palette indices...\n" : "Converting the pixels...\n");
+	image.Resize(m_stHeaders.width, m_stHeaders.height, GetImageFormat());
+	size_t rowBytes = GetSampleFormat().RowBytes(m_stHeaders.width);
+	if (data.size() < image.Height() * (rowBytes + 1))
+		throw "Not enough image data!";
+
+	PNGUnfilter unfilter(GetSampleFormat().PixelSize());
+	BeginConvertedRows();
+	for (size_t y = 0; y < image.Height(); y++) {
+		ConvertRow(y, data.data() + y * (rowBytes + 1), image, unfilter);
+	}
 }
 
-byte_t PNG::UpFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte)
+void PNG::BeginConvertedRows()
 {
-	return (y == 0) ? 0 : scanlines.at(y - 1).pixels.at(x).bytes.at(byte);
+	size_t size = 2 * (GetSampleFormat().RowBytes(m_stHeaders.width) + UNFILTER_PADDING);
+	if (m_vScanlines.size() < size)
+		m_vScanlines.resize(size);
+	memset(m_vScanlines.data(), 0, size); // The row above the first one is a row of zeros
 }
 
-byte_t PNG::AverageFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte)
+void PNG::ConvertRow(const size_t & y, const byte_t * filtered, Image & image, const PNGUnfilter & unfilter)
 {
-	uint32_t sum = (uint32_t)SubFilter(scanlines, x, y, byte) + (uint32_t)UpFilter(scanlines, x, y, byte); // Make sure to prevent integer overflow
-	return (byte_t)(sum / 2);
+	// The rows take turns in the two halves of m_vScanlines, so the other half is always the previous row.
+	// The row is converted right after it is unfiltered, while it is still in the cache
+	size_t rowBytes = GetSampleFormat().RowBytes(m_stHeaders.width);
+	byte_t *current = m_vScanlines.data() + (y % 2) * (rowBytes + UNFILTER_PADDING);
+	const byte_t *previous = m_vScanlines.data() + ((y + 1) % 2) * (rowBytes + UNFILTER_PADDING);
+	image.Filter(y) = filtered[0];
+	memcpy(current, filtered + 1, rowBytes);
+	unfilter.UnfilterRow(filtered[0], current, previous, rowBytes);
+	ConvertSamples(current, image.Row(y));
 }
 
-byte_t PNG::PaethFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte)
+void PNG::ConvertSamples(const byte_t * row, byte_t * output)
 {
-	//  For more info: https://www.w3.org/TR/2003/REC-PNG-20031110/#9Filter-type-4-Paeth
-	int a, b, c, p, pa, pb, pc; // Using signed int to prevent under or overflow
-	a = SubFilter(scanlines, x, y, byte);
-	b = UpFilter(scanlines, x, y, byte);
-	c = (y == 0 || x == 0) ? 0 : scanlines.at(y - 1).pixels.at(x - 1).bytes.at(byte);
-	p = a + b - c;
-	pa = abs(p - a);
-	pb = abs(p - b);
-	pc = abs(p - c);
-	return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+	if (IsIndexed())
+		m_oPalette.ExpandRow(row, output);
+	else
+		m_oConverter.ConvertRow(row, output, m_stHeaders.width);
+}
+
+uint32_t PNG::GetDecodedPasses() const
+{
+	return (m_uPreviewPasses == 0 || m_uPreviewPasses > ADAM7_PASSES) ? ADAM7_PASSES : m_uPreviewPasses;
+}
+
+size_t PNG::GetPassDataSize(const uint32_t & pass)
+{
+	uint32_t width = Adam7Passes[pass].Width(m_stHeaders.width);
+	uint32_t height = Adam7Passes[pass].Height(m_stHeaders.height);
+	if (width == 0 || height == 0)
+		return 0; // Empty passes have no scanlines at all, not even the filter bytes
+	return (size_t)height * (GetSampleFormat().RowBytes(width) + 1);
+}
+
+bool PNG::DecodeInterlaced(binary_t & buffer, Image & image)
+{
+	uint32_t passes = GetDecodedPasses();
+	size_t size = 0;
+	for (uint32_t pass = 0; pass < passes; pass++)
+		size += GetPassDataSize(pass);
+	buffer.resize(size);
+	m_oInflator.SetVerbose(m_bVerbose);
+	IDATSource source(*this);
+	if (passes < ADAM7_PASSES) {
+		// The passes are stored one after the other, so a preview needs only the beginning of the data
+		m_oInflator.DecompressPrefix(source, buffer.data(), buffer.size());
+	}
+	else {
+		m_oInflator.Decompress(source, buffer.data(), buffer.size());
+		if (!ReadRemainingChunks())
+			return false;
+	}
+	DeinterlacePasses(buffer, image, passes);
+	return true;
+}
+
+void PNG::DeinterlacePasses(const binary_t & data, Image & image, const uint32_t & passes)
+{
+	if (m_bVerbose)
+		std::cout << "Reconstructing the interlaced passes...\n";
+	uint32_t scaleX, scaleY;
+	GetAdam7Scale(passes, scaleX, scaleY);
+	image.Resize((m_stHeaders.width + scaleX - 1) / scaleX, (m_stHeaders.height + scaleY - 1) / scaleY, GetImageFormat());
+
+	// Each pass is unfiltered after a row of zeros and is followed by the bytes that the unfilter kernels may read
+	const byte_t *passData[ADAM7_PASSES];
+	size_t offset = 0, size = 0;
+	for (uint32_t pass = 0; pass < passes; pass++) {
+		passData[pass] = data.data() + offset;
+		offset += GetPassDataSize(pass);
+		const Adam7Pass &position = Adam7Passes[pass];
+		size_t rowBytes = GetSampleFormat().RowBytes(position.Width(m_stHeaders.width));
+		m_aPassOffsets[pass] = size + rowBytes;
+		size += rowBytes * (1 + (size_t)position.Height(m_stHeaders.height)) + UNFILTER_PADDING;
+	}
+	if (data.size() < offset)
+		throw "Not enough image data!";
+	if (m_vPassPixels.size() < size)
+		m_vPassPixels.resize(size);
+
+	// A decode that runs on a pool thread(e.g. in a batch) already has the other threads busy
+	ThreadPool *pool = (offset >= PARALLEL_PASSES_MIN_SIZE && !ThreadPool::IsWorkerThread()) ? m_pThreadPool : nullptr;
+	size_t workers = (pool != nullptr) ? pool->Size() : 1;
+	if (m_vWorkerRows.size() < workers)
+		m_vWorkerRows.resize(workers);
+	for (size_t worker = 0; worker < workers; worker++) {
+		if (m_vWorkerRows[worker].size() < image.RowBytes() + image.Width())
+			m_vWorkerRows[worker].resize(image.RowBytes() + image.Width());
+	}
+
+	if (pool == nullptr) {
+		for (uint32_t pass = 0; pass < passes; pass++)
+			UnfilterPass(pass, passData[pass]);
+		ScatterPasses(0, image.Height(), image, 0);
+		return;
+	}
+
+	// The rows of a pass depend on the rows above them, so each pass is a single task(the last pass has about as many
+	// pixels as all the others together). The rows of the image are independent, so they are split in bands.
+	// The tasks capture only two references, so std::function doesn't allocate them
+	pool->Run(passes, [this, &passData](const size_t &, const size_t &pass) {
+		UnfilterPass((uint32_t)pass, passData[pass]);
+	});
+	struct {
+		Image *image;
+		size_t count;
+	} bands = { &image, std::min((size_t)image.Height(), workers * PASS_BANDS_PER_THREAD) };
+	pool->Run(bands.count, [this, &bands](const size_t &worker, const size_t &band) {
+		uint32_t height = bands.image->Height();
+		ScatterPasses((uint32_t)(height * band / bands.count), (uint32_t)(height * (band + 1) / bands.count), *bands.image, worker);
+	});
+}
+
+void PNG::UnfilterPass(const uint32_t & pass, const byte_t * data)
+{
+	const Adam7Pass &position = Adam7Passes[pass];
+	uint32_t width = position.Width(m_stHeaders.width);
+	uint32_t height = position.Height(m_stHeaders.height);
+	if (width == 0 || height == 0)
+		return;
+
+	PNGUnfilter unfilter(GetSampleFormat().PixelSize());
+	size_t rowBytes = GetSampleFormat().RowBytes(width);
+	byte_t *previous = m_vPassPixels.data() + m_aPassOffsets[pass] - rowBytes;
+	memset(previous, 0, rowBytes);
+	for (uint32_t y = 0; y < height; y++, data += rowBytes + 1) {
+		byte_t *current = previous + rowBytes;
+		memcpy(current, data + 1, rowBytes);
+		unfilter.UnfilterRow(data[0], current, previous, rowBytes);
+		previous = current;
+	}
+}
+
+void PNG::ScatterPasses(const uint32_t & begin, const uint32_t & end, Image & image, const size_t & worker)
+{
+	uint32_t passes = GetDecodedPasses();
+	uint32_t scaleX, scaleY;
+	GetAdam7Scale(passes, scaleX, scaleY);
+	byte_t *converted = m_vWorkerRows[worker].data();
+	byte_t *indices = converted + image.RowBytes();
+	size_t bitsPerPixel = image.Format().BitsPerPixel();
+
+	for (uint32_t y = begin; y < end; y++) {
+		byte_t *row = image.Row(y);
+		// The passes keep the bits they don't write, so the unused bits at the end of the row would keep the
+		// values of the previous image in the buffer
+		if (bitsPerPixel < 8)
+			memset(row, 0, image.RowBytes());
+
+		// Every pass that has pixels in this row, the last passes fill the gaps between the pixels of the first ones
+		uint32_t imageY = y * scaleY;
+		for (uint32_t pass = 0; pass < passes; pass++) {
+			const Adam7Pass &position = Adam7Passes[pass];
+			uint32_t width = position.Width(m_stHeaders.width);
+			if (width == 0 || imageY < position.y0 || (imageY - position.y0) % position.dy != 0)
+				continue;
+
+			size_t rowBytes = GetSampleFormat().RowBytes(width);
+			const byte_t *pixels = m_vPassPixels.data() + m_aPassOffsets[pass] + (size_t)((imageY - position.y0) / position.dy) * rowBytes;
+			if (IsIndexed()) {
+				m_oPalette.ExpandRow(pixels, converted, width, indices);
+				pixels = converted;
+			}
+			else if (!m_oConverter.IsIdentity()) {
+				m_oConverter.ConvertRow(pixels, converted, width);
+				pixels = converted;
+			}
+			ScatterRow(pixels, width, row, position.x0 / scaleX, position.dx / scaleX, bitsPerPixel);
+		}
+	}
 }
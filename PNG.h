@@ -5,8 +5,32 @@
 #include <iostream>
 #include <Binary.h>
 #include "PNGInflator.h"
+#include "Image.h"
+#include "PNGUnfilter.h"
+#include "ScanlineReader.h"
+#include "RowQueue.h"
+#include "WorkerThread.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "CRC32.h"
+#include "Palette.h"
+#include "PixelConverter.h"
+#include "Adam7.h"
 
-extern uint32_t PNG_Signature[2]; // The PNG signature in Network-byte-order (Big-Endian)
+#define PNG_SIGNATURE_SIZE 8
+extern const byte_t PNG_Signature[PNG_SIGNATURE_SIZE]; // The first 8 bytes of every PNG datastream
+
+#define CHUNK_PROPERTY_BIT 0x20 // Bit 5 of each letter of the chunk type(lowercase letter)
+#define PARALLEL_PASSES_MIN_SIZE (1 << 18) // Interlaced images with less decompressed data are not worth the thread pool
+#define DEFAULT_SIZE_LIMIT ((uint64_t)1 << 29) // 512 MiB for the decompressed data and for the decoded image
+#define PASS_BANDS_PER_THREAD 4 // Tasks for each pool thread when the passes are scattered to the image rows
+
+// Chunk type as an integer with the first letter in the most significant byte, e.g. ChunkCode("IDAT")
+constexpr uint32_t ChunkCode(const char (&name)[5])
+{
+	return ((uint32_t)(uint8_t)name[0] << 24) | ((uint32_t)(uint8_t)name[1] << 16) |
+		((uint32_t)(uint8_t)name[2] << 8) | (uint32_t)(uint8_t)name[3];
+}
 
 
 // The next structures are wrapped in #pragma pack in order to avoid padding and 
@@ -15,12 +39,21 @@ extern uint32_t PNG_Signature[2]; // The PNG signature in Network-byte-order (Bi
 struct ChunkHeader {
 	uint32_t dataLength;
 	char type[4];
+
+	// The type in the same form as ChunkCode()
+	uint32_t Code() const { uint32_t code; memcpy(&code, type, sizeof(code)); return Binary::ByteSwap(code); }
+	// The properties encoded in the case of the letters. A decoder that doesn't know an ancillary
+	// chunk can ignore it, but it can't decode an image with an unknown critical chunk
+	bool IsAncillary() const { return (type[0] & CHUNK_PROPERTY_BIT) != 0; }
+	bool IsPrivate() const { return (type[1] & CHUNK_PROPERTY_BIT) != 0; }
+	bool IsReserved() const { return (type[2] & CHUNK_PROPERTY_BIT) != 0; } // Must be 0(uppercase) in valid chunks
+	bool IsSafeToCopy() const { return (type[3] & CHUNK_PROPERTY_BIT) != 0; }
 };
 
 struct Chunk
 {
 	ChunkHeader header;
-	Binary data;
+	const byte_t *data; // Points into the file data, which is not copied
 	uint32_t CRC;
 };
 
@@ -34,47 +67,19 @@ struct IHDRData {
 	uint8_t interlaceMethod;
 };
 
-struct Pixel {
-	Pixel() {}
-	Pixel(const size_t &size) { SetSize(size); }
-	Pixel(const Pixel &pObj) : bytes(pObj.bytes) { }
-	void SetSize(const size_t &size) { if (size != 3 && size != 4) { throw "Invalid pixel size provided!"; } bytes.resize(size); }
-	uint8_t Red() const { return bytes.at(0); }
-	uint8_t Green() const { return bytes.at(1); }
-	uint8_t Blue() const { return bytes.at(2); }
-	uint8_t Alpha() const { return (bytes.size() == 4) ? bytes.at(3) : UINT8_MAX; }
-	uint32_t ToInteger() const {
-		return (bytes.size() == 3) ?
-			(uint32_t)((bytes.at(0) << 16) | (bytes.at(1) << 8) | bytes.at(2)) :
-			(uint32_t)((bytes.at(0) << 24) | (bytes.at(1) << 16) | (bytes.at(2) << 8) | bytes.at(3));
-	}
-	// The commented code is no longer used, but I'm not sure whether I want to remove it not.
-	/*void FromInteger(const uint32_t &color) {
-		size_t size = bytes.size();
-		bytes.at(0) = (uint8_t)((color >> (size - 1) * 8) & 0xFF);
-		bytes.at(1) = (uint8_t)((color >> (size - 2) * 8) & 0xFF);
-		bytes.at(2) = (uint8_t)((color >> (size - 3) * 8) & 0xFF);
-		if (size == 4)
-			bytes.at(3) = (uint8_t)(color & 0xFF);
-	}
-	friend Pixel operator + (const Pixel &left, const Pixel &right) {
-		Pixel p(left.bytes.size());
-		p.bytes.at(0) = (uint8_t)(left.Red() + right.Red());
-		p.bytes.at(1) = (uint8_t)(left.Green() + right.Green());
-		p.bytes.at(2) = (uint8_t)(left.Blue() + right.Blue());
-		if (p.bytes.size() == 4)
-			p.bytes.at(3) = (uint8_t)(left.Alpha() + right.Alpha());
-
-		return p;
-	}
-	void operator = (const Pixel &right) { bytes = right.bytes; }
-	friend void operator += (Pixel &left, const Pixel &right) { left = left + right; }*/
-	binary_t bytes;
+struct PHYsData {
+	uint32_t pixelsPerUnitX;
+	uint32_t pixelsPerUnitY;
+	uint8_t unit; // 0 - unknown(only the aspect ratio is known), 1 - meter
 };
 
-struct Scanline {
-	byte_t filter;
-	std::vector<Pixel> pixels;
+struct TIMEData {
+	uint16_t year;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t second;
 };
 #pragma pack(pop)
 
@@ -91,6 +96,13 @@ enum class ChunkType {
 	tIME // Time information
 };
 
+// Which chunks have their CRC checked while reading
+enum class CRCPolicy {
+	VERIFY_ALL, // For untrusted input
+	VERIFY_CRITICAL, // IHDR, PLTE, IDAT and IEND(and unknown critical chunks)
+	SKIP // For trusted files
+};
+
 enum class BitDepth {
 	UNKNOWN = -1,
 	DEPTH1 = 1,
@@ -109,48 +121,209 @@ enum class ColorType {
 	TRUECOLORA	= 6  // | 8, 16				| Each pixel is an R,G,B triple followed by an alpha sample.
 };
 
+// Position of a chunk inside the datastream
+struct ChunkInfo {
+	ChunkType type;
+	char name[4];
+	size_t offset; // Offset of the chunk data from the start of the datastream
+	uint32_t length; // Length of the chunk data
+};
+
+// A keyword and its text from a tEXt chunk
+struct TextEntry {
+	std::string keyword;
+	std::string text;
+};
+
+// Result of PNG::Probe()
+struct PNGInfo {
+	IHDRData header;
+	std::vector<ChunkInfo> chunks; // Every chunk in order, including IHDR and IEND
+	bool hasPHYs;
+	PHYsData pHYs;
+	bool hasTIME;
+	TIMEData tIME;
+	std::vector<TextEntry> texts;
+};
+
 //extern Pixel *FilterFunction(const std::vector<Scanline>&, const size_t&, const size_t&);
 
+class PNG;
+
+// Passes the IDAT chunks to the inflator one by one. The next chunk is read only when the inflator reaches it
+class IDATSource : public ByteSource
+{
+public:
+	IDATSource(PNG &png) : m_oPNG(png) {}
+	bool NextSegment(const byte_t *&data, size_t &size) override;
+
+private:
+	PNG &m_oPNG;
+};
+
 class PNG
 {
+	friend class IDATSource;
+
 public:
 	// Constuctors and Destructor
-	PNG() {}
-	PNG(const std::string &filepath) { Open(filepath); }
-	PNG(const char *filepath, const size_t &size) { Open(filepath, size); }
+	PNG() : m_pInput(nullptr), m_uInputSize(0), m_uPosition(0), m_bVerbose(true), m_eCRCPolicy(CRCPolicy::VERIFY_ALL), m_eOutputFormat(OutputFormat::NATIVE),
+		m_uPreviewPasses(0), m_uSizeLimit(DEFAULT_SIZE_LIMIT), m_pThreadPool(nullptr), m_sError(nullptr) {}
+	PNG(const std::string &filepath) : PNG() { Open(filepath); }
+	PNG(const char *filepath, const size_t &size) : PNG() { Open(filepath, size); }
 	~PNG();
 
 	// Public methods
 	void Open(const std::string &filepath) { Open(filepath.c_str(), filepath.length() + 1); }
+	// The file is memory-mapped when it is read
 	void Open(const char *filepath, const size_t &size);
+	// Reads the PNG from memory owned by the caller. It must stay valid while the object is used
+	void OpenMemory(const byte_t *data, const size_t &size);
+	// Unmaps the file and forgets the input, the buffers are kept for the next image
+	void Close();
 	void ReadFile();
+	// Same as ReadFile(), but the image data is decompressed in "buffer", which is resized to GetDataSize().
+	// Reusing the same buffer for multiple images avoids the allocation when it is already big enough
+	void ReadFile(binary_t &buffer);
+	// Decodes the image(see GetImage()) without printing it, the data is decompressed in "buffer" like in ReadFile().
+	// Returns false if the file is not valid(see GetError()), a corrupted stream throws an exception
+	bool Decode(binary_t &buffer);
+	// Same as Decode(), but the image is stored in "image" instead of the one returned by GetImage()
+	bool Decode(binary_t &buffer, Image &image);
+	// Reads only the metadata: validates the signature, parses IHDR, pHYs, tIME and tEXt and makes an index of
+	// all chunks. The chunks are skipped using their length, so the image data is never read.
+	// Returns false if the file is not valid(see GetError())
+	bool Probe(PNGInfo &info);
+	// Streaming alternative of ReadFile(), the rows are passed to the callback as soon as they are decompressed and unfiltered.
+	// The rows of interlaced images are complete only after the last pass, so they are passed once the whole image is decoded
+	void ReadRows(const RowCallback &callback);
+	// Same result as ReadFile(), but the filters are reversed on a second thread while the data is still being decompressed.
+	// Interlaced images are decoded like in ReadFile()
+	void ReadFilePipelined();
+	// Same as Decode(), but pipelined like ReadFilePipelined(). "buffer" is used only by interlaced images. The row queue
+	// and the second thread are kept for the next images, so the thread is started only once
+	bool DecodePipelined(binary_t &buffer, Image &image);
+	// Every valid color type and bit depth combination is supported, both without and with(Adam7) interlacing
 	bool IsSupported();
+	// Size of the decompressed image data(the filter byte of each row included), known once the headers are read
+	size_t GetDataSize();
+	bool IsInterlaced() const { return m_stHeaders.interlaceMethod == 1; }
 	void PrintHeaderInfo(std::ostream &stream);
-	void PrintHexPixels(const std::vector<Scanline> &scanlines, std::ostream &stream);
+	void PrintHexPixels(const Image &image, std::ostream &stream);
+	const Image &GetImage() const { return m_oImage; }
+	// Size of the PNG datastream that was read
+	size_t GetInputSize() const { return m_uInputSize; }
+	// The reason of the last failure or nullptr
+	const char *GetError() const { return m_sError; }
+	// The progress messages are printed to std::cout and the errors to std::cerr only if verbose(the default)
+	void SetVerbose(const bool &verbose) { m_bVerbose = verbose; }
+	// VERIFY_ALL by default. A chunk with a wrong CRC throws an exception. SKIP also turns off the Adler-32 check of the image data
+	void SetCRCPolicy(const CRCPolicy &policy) { m_eCRCPolicy = policy; m_oInflator.SetChecksum(policy != CRCPolicy::SKIP); }
+	// NATIVE by default. The conversion is done while the rows are unfiltered, the rows passed to the
+	// callback of ReadRows() are converted as well
+	void SetOutputFormat(const OutputFormat &format) { m_eOutputFormat = format; }
+	// Decodes only the first "passes"(1-7) Adam7 passes of interlaced images, 0(the default) decodes all of them. The
+	// image is a low-resolution preview with one pixel for each block that is known after those passes(see GetAdam7Scale()).
+	// Only the beginning of the image data is decompressed and the chunks after it are not read. Non-interlaced images
+	// are always decoded whole
+	void SetPreviewPasses(const uint32_t &passes) { m_uPreviewPasses = passes; }
+	// DEFAULT_SIZE_LIMIT by default. Images whose decompressed data or decoded image would take more bytes are rejected
+	// before anything is allocated for them(see GetError()). The limit is lowered to half the address space if needed
+	void SetSizeLimit(const uint64_t &bytes) { m_uSizeLimit = bytes; }
+	// Large interlaced images are reconstructed on the pool: the passes are unfiltered in parallel and then the image
+	// is split in bands of rows. The pool is not used by a decode that already runs on a pool thread(see BatchDecoder).
+	// nullptr(the default) reconstructs the images on the calling thread. The pool must outlive its use. Decoders on
+	// different threads may share a pool, it runs the batches of their images one after the other
+	void SetThreadPool(ThreadPool *pool) { m_pThreadPool = pool; }
 
 private: // Methods
-	bool CheckSignature(const uint32_t bytes[2]);
-	ChunkType GetChunkType(const Chunk &chunk);
-	ChunkType GetChunkType(const ChunkHeader &header);
-	Chunk ReadChunk(std::ifstream &file);
+	// Opens the input, checks the signature and parses the IHDR chunk, returns false if the file is not valid
+	bool ReadHeaderChunk(Chunk &IHDR);
+	// Reads the chunks up to the first IDAT chunk, returns false if the file is not valid
+	bool ReadChunks();
+	// Selects the conversion from the samples to the output format, called once the palette is read
+	void PrepareOutput();
+	// Returns the next IDAT chunk or false after the last one
+	bool NextDataChunk(Chunk &chunk);
+	// Reads the chunks after the image data up to IEND
+	bool ReadRemainingChunks();
+	// Sets the error and returns false
+	bool Fail(const char *error);
+	// Compares all 8 bytes with the PNG signature
+	bool CheckSignature(const byte_t *bytes);
+	static ChunkType GetChunkType(const Chunk &chunk);
+	static ChunkType GetChunkType(const ChunkHeader &header);
+	// Returns false if the chunk is not known and it is critical. Unknown ancillary chunks are only logged(when verbose)
+	bool CheckUnknownChunk(const Chunk &chunk);
+	// Reads the next chunk and checks its CRC(unless "verify" is false, see VerifyCRC())
+	Chunk ReadChunk(const bool &verify = true);
+	// Checks the CRC of the chunk if the policy requires it
+	void VerifyCRC(const Chunk &chunk);
 	void ParseHeaders(Chunk &IHDR);
-	Chunk MergeDataChunks(std::vector<Chunk> &IDATs);
+	// True if the buffers for the image fit in the size limit, checked before any of them is allocated
+	bool IsWithinSizeLimit();
+	// Parses the small chunks that are part of PNGInfo and adds the chunk to the index
+	void ProbeChunk(const Chunk &chunk, PNGInfo &info);
+	// The samples of the scanlines, for indexed images these are the palette indices
+	SampleFormat GetSampleFormat();
+	// The format of the decoded image after the palette expansion and the conversion to the output format
+	SampleFormat GetImageFormat();
+	bool IsIndexed() const { return m_stHeaders.colorType == (uint8_t)ColorType::INDEXED; }
+	// True if the reconstructed rows can't be stored in the image as they are(indexed or converted images)
+	bool IsConverted() const { return IsIndexed() || !m_oConverter.IsIdentity(); }
 	const char *GetColorTypeString(const ColorType &colorType);
-	std::vector<Scanline> ReadScanlines(Binary &data);
-	void ApplyFilters(std::vector<Scanline> &scanlines);
-	void ApplyFilterToScanline(std::vector<Scanline> &scanlines, const size_t &lineNum, byte_t(PNG::* fn)(const std::vector<Scanline>&, const size_t&, const size_t&, const size_t &));
-	// Returns the value from the same channel(byte) in the left pixel(pixel "a") or 0 if the curent pixel is the leftmost 
-	byte_t SubFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte);
-	// Returns the value from the same channel(byte) in the top pixel(pixel "c") or 0 if the curent pixel is the topmost 
-	byte_t UpFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte);
-	// Returns the average value of the above 2 filters rounded down to the nearest integer value
-	byte_t AverageFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte);
-	// After some linear computations returns either SubFilter, UpFilter or the value form the same channel(byte) in the top-left pixel(pixel c)
-	byte_t PaethFilter(const std::vector<Scanline> &scanlines, const size_t &x, const size_t &y, const size_t &byte);
+	void ReadScanlines(const binary_t &data, Image &image);
+	void ApplyFilters(Image &image);
+	// Reverses the filters of the rows and converts them to the image format, one row at a time
+	void ConvertRows(const binary_t &data, Image &image);
+	// Prepares m_vScanlines for ConvertRow()
+	void BeginConvertedRows();
+	// "filtered" is a scanline starting with the filter byte, the result is written in row "y" of the image
+	void ConvertRow(const size_t &y, const byte_t *filtered, Image &image, const PNGUnfilter &unfilter);
+	// Expands the palette indices or converts the samples of a reconstructed row
+	void ConvertSamples(const byte_t *row, byte_t *output);
+	// Runs on the unfilter thread of DecodePipelined(), aborts the queue if it fails
+	void UnfilterRows(RowQueue &queue, Image &image);
+	// Number of passes that are decoded, see SetPreviewPasses()
+	uint32_t GetDecodedPasses() const;
+	// Size of the scanlines of the pass(filter bytes included), 0 for passes without pixels
+	size_t GetPassDataSize(const uint32_t &pass);
+	// Decompresses the passes and reconstructs the image, called after ReadChunks()
+	bool DecodeInterlaced(binary_t &buffer, Image &image);
+	// Reverses the filters of each pass and scatters its pixels to their place in the image
+	void DeinterlacePasses(const binary_t &data, Image &image, const uint32_t &passes);
+	// Reverses the filters of the scanlines of a pass(starting at "data") into its place in m_vPassPixels
+	void UnfilterPass(const uint32_t &pass, const byte_t *data);
+	// Copies the pixels of the decoded passes to the image rows [begin, end), using the scratch row of "worker"
+	void ScatterPasses(const uint32_t &begin, const uint32_t &end, Image &image, const size_t &worker);
 
 private: // Variables
-	char *m_sFilePath;
+	std::string m_sFilePath; // Empty when reading from memory
+	MappedFile m_oFile;
+	const byte_t *m_pInput; // The whole PNG datastream, either mapped from a file or provided by the caller
+	size_t m_uInputSize;
+	size_t m_uPosition;
 	IHDRData m_stHeaders;
-	Chunk m_stIDAT;
+	Chunk m_stIDAT; // The first IDAT chunk
+	Chunk m_stDataEnd; // The first chunk after the IDAT chunks
+	bool m_bFirstIDATPending;
+	bool m_bDataFinished;
+	bool m_bVerbose;
+	CRCPolicy m_eCRCPolicy;
+	OutputFormat m_eOutputFormat;
+	uint32_t m_uPreviewPasses;
+	uint64_t m_uSizeLimit;
+	ThreadPool *m_pThreadPool;
+	const char *m_sError;
+	PNGInflator m_oInflator; // Kept between the images, so its window and tables are allocated only once
+	Palette m_oPalette;
+	PixelConverter m_oConverter; // Not used for indexed images, their palette is converted instead
+	binary_t m_vScanlines; // The previous and the current reconstructed row while converting the rows
+	binary_t m_vPassPixels; // The unfiltered passes, each after a row of zeros(the row above its first row)
+	size_t m_aPassOffsets[ADAM7_PASSES]; // The first row of each pass in m_vPassPixels
+	std::vector<binary_t> m_vWorkerRows; // The converted row and the palette indices of each pool thread
+	Image m_oImage;
+	RowQueue m_oRowQueue; // The rows between the two threads of DecodePipelined()
+	WorkerThread m_oUnfilterThread;
 };
 
@@ -3,30 +3,308 @@
 uint32_t LengthsOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
 PNGInflator::PNGInflator()
-	:m_uWindowSize(0), m_oLookback(32 * 1024)
+	:m_uWindowSize(0), m_oLookback(32 * 1024),
+	m_oStaticLitLen(FixedLitLenTable.entries, LITLEN_ROOT_BITS), m_oStaticDist(FixedDistTable.entries, DIST_ROOT_BITS),
+	m_oCodeLengths(m_aTableArena, CLEN_TABLE_SIZE, CLEN_ROOT_BITS),
+	m_oDynamicLitLen(m_aTableArena + CLEN_TABLE_SIZE, LITLEN_TABLE_SIZE, LITLEN_ROOT_BITS),
+	m_oDynamicDist(m_aTableArena + CLEN_TABLE_SIZE + LITLEN_TABLE_SIZE, DIST_TABLE_SIZE, DIST_ROOT_BITS),
+	m_bChecksum(true), m_bVerbose(true)
 {
-	m_pLitDist.first = GenerateStaticLitLen();
-	m_pLitDist.second = GenerateStaticDist();
 }
 
 
 PNGInflator::~PNGInflator()
 {
-	FreeHuffmanTree(m_pLitDist.first);
-	FreeHuffmanTree(m_pLitDist.second);
 }
 
-Binary PNGInflator::Decompress(Binary compressedData)
+// Copies a back-reference that ends right before "dst". When the distance is shorter than the length
+// the source overlaps the bytes being written, in which case the data repeats with a period of "distance"
+static inline void CopyMatch(byte_t *dst, const size_t &distance, size_t length)
 {
-	m_oData = compressedData;
-	ReadHeaders();
+	const byte_t *src = dst - distance;
+	if (distance >= length) {
+		memcpy(dst, src, length);
+	}
+	else if (distance == 1) {
+		memset(dst, *src, length); // Run of a single byte
+	}
+	else {
+		// Every copied block doubles the length of the repeated pattern, so the blocks never overlap
+		size_t period = distance;
+		while (length > 0) {
+			size_t count = std::min(period, length);
+			memcpy(dst, src, count);
+			dst += count;
+			length -= count;
+			period *= 2;
+		}
+	}
+}
+
+// Adler-32 of the decompressed stream. The buffered outputs update it in steps of STREAM_FLUSH_SIZE bytes
+// right after writing them, while the data is still in the cache. Matches and stored parts step it themselves,
+// the literals are covered by the Step() of the output, which DecodeBlock() calls every CHECKSUM_STEP_SYMBOLS symbols
+class OutputChecksum
+{
+public:
+	OutputChecksum(const bool &enabled) : m_bEnabled(enabled), m_uAdler(1), m_uChecked(0) {}
+	// "data" is the beginning of the output and "size" the number of bytes written so far
+	void Step(const byte_t *data, const size_t &size) {
+		if (size - m_uChecked >= STREAM_FLUSH_SIZE)
+			Update(data, size);
+	}
+	void Update(const byte_t *data, const size_t &size) {
+		if (m_bEnabled)
+			m_uAdler = UpdateAdler32(m_uAdler, data + m_uChecked, size - m_uChecked);
+		m_uChecked = size;
+	}
+	uint32_t Value() const { return m_uAdler; }
+
+private:
+	bool m_bEnabled;
+	uint32_t m_uAdler;
+	size_t m_uChecked;
+};
+
+// Writes the whole decompressed stream in a single buffer and copies the back-references from the already written data
+class BufferOutput
+{
+public:
+	BufferOutput(binary_t &data, const bool &checksum) : m_vData(data), m_uSize(0), m_oChecksum(checksum) {}
+	void Literal(const byte_t &byte) {
+		if (m_uSize == m_vData.size())
+			Grow(1);
+		m_vData[m_uSize++] = byte;
+	}
+	void Match(const uint32_t &distance, const uint32_t &length) {
+		if (distance > m_uSize)
+			throw "Distance points before the beginning of the stream!";
+		if (m_vData.size() - m_uSize < length)
+			Grow(length);
+		CopyMatch(m_vData.data() + m_uSize, distance, length);
+		m_uSize += length;
+		m_oChecksum.Step(m_vData.data(), m_uSize);
+	}
+	void Stored(const byte_t *data, const size_t &size) {
+		if (size == 0)
+			return; // An empty stored block, the buffer may still be empty(memcpy() doesn't accept a null pointer)
+		if (m_vData.size() - m_uSize < size)
+			Grow(size);
+		memcpy(m_vData.data() + m_uSize, data, size);
+		m_uSize += size;
+		m_oChecksum.Step(m_vData.data(), m_uSize);
+	}
+	void Step() { m_oChecksum.Step(m_vData.data(), m_uSize); }
+	void Finish() {
+		m_oChecksum.Update(m_vData.data(), m_uSize);
+		m_vData.resize(m_uSize);
+	}
+	uint32_t Checksum() const { return m_oChecksum.Value(); }
+	bool Full() const { return false; } // The stream is always decompressed to its end
+
+private:
+	void Grow(const size_t &required) { m_vData.resize(std::max(m_vData.size() * 2, m_uSize + std::max(required, (size_t)STREAM_FLUSH_SIZE))); }
+
+private:
+	binary_t &m_vData;
+	size_t m_uSize;
+	OutputChecksum m_oChecksum;
+};
+
+// Writes the decompressed stream in a buffer supplied by the caller. The buffer must have exactly the size of the stream,
+// unless only the beginning of the stream is needed("Prefix"), in which case the decompression stops once the buffer is full
+template <bool Prefix>
+class FixedOutput
+{
+public:
+	FixedOutput(byte_t *data, const size_t &capacity, const bool &checksum) : m_pData(data), m_uCapacity(capacity), m_uSize(0), m_oChecksum(checksum) {}
+	void Literal(const byte_t &byte) {
+		if (m_uSize == m_uCapacity) {
+			if (Prefix)
+				return;
+			throw "The decompressed data doesn't fit in the output buffer!";
+		}
+		m_pData[m_uSize++] = byte;
+	}
+	void Match(const uint32_t &distance, uint32_t length) {
+		if (distance > m_uSize)
+			throw "Distance points before the beginning of the stream!";
+		if (m_uCapacity - m_uSize < length) {
+			if (!Prefix)
+				throw "The decompressed data doesn't fit in the output buffer!";
+			length = (uint32_t)(m_uCapacity - m_uSize);
+		}
+		CopyMatch(m_pData + m_uSize, distance, length);
+		m_uSize += length;
+		m_oChecksum.Step(m_pData, m_uSize);
+	}
+	void Stored(const byte_t *data, size_t size) {
+		if (size == 0)
+			return; // The output may be empty and null
+		if (m_uCapacity - m_uSize < size) {
+			if (!Prefix)
+				throw "The decompressed data doesn't fit in the output buffer!";
+			size = m_uCapacity - m_uSize;
+		}
+		memcpy(m_pData + m_uSize, data, size);
+		m_uSize += size;
+		m_oChecksum.Step(m_pData, m_uSize);
+	}
+	void Step() { m_oChecksum.Step(m_pData, m_uSize); }
+	void Finish() {
+		if (m_uSize != m_uCapacity)
+			throw "The decompressed stream is shorter than the output buffer!";
+		m_oChecksum.Update(m_pData, m_uSize);
+	}
+	uint32_t Checksum() const { return m_oChecksum.Value(); }
+	bool Full() const { return Prefix && m_uSize == m_uCapacity; }
+
+private:
+	byte_t *m_pData;
+	size_t m_uCapacity;
+	size_t m_uSize;
+	OutputChecksum m_oChecksum;
+};
+
+// Keeps only the lookback window and passes the decompressed bytes to the sink as they are produced.
+// The checksum is updated with each part on its way to the sink
+class StreamOutput
+{
+public:
+	StreamOutput(RingBuffer &window, const ByteSink &sink, const bool &checksum)
+		: m_oWindow(window), m_fnSink(sink), m_bChecksum(checksum), m_uAdler(1),
+		m_fnChecked([this](const byte_t *data, const size_t &size) { Write(data, size); }) {}
+	void Literal(const byte_t &byte) {
+		m_oWindow.AppendByte(byte);
+		FlushIfNeeded();
+	}
+	void Match(const uint32_t &distance, const uint32_t &length) {
+		m_oWindow.CopyMatch(distance, length);
+		FlushIfNeeded();
+	}
+	void Stored(const byte_t *data, const size_t &size) {
+		if (size < STREAM_FLUSH_SIZE) {
+			m_oWindow.AppendData(data, size);
+			FlushIfNeeded();
+			return;
+		}
+		// Large parts are passed to the sink directly from the input, the window only needs their end
+		m_oWindow.Flush(m_fnChecked);
+		Write(data, size);
+		m_oWindow.AppendHistory(data, size);
+	}
+	void Step() {} // The checksum is updated by the flushes
+	void Finish() { m_oWindow.Flush(m_fnChecked); }
+	uint32_t Checksum() const { return m_uAdler; }
+	bool Full() const { return false; }
+
+private:
+	void FlushIfNeeded() {
+		if (m_oWindow.Pending() >= STREAM_FLUSH_SIZE)
+			m_oWindow.Flush(m_fnChecked);
+	}
+	void Write(const byte_t *data, const size_t &size) {
+		if (m_bChecksum)
+			m_uAdler = UpdateAdler32(m_uAdler, data, size);
+		m_fnSink(data, size);
+	}
+
+private:
+	RingBuffer &m_oWindow;
+	const ByteSink &m_fnSink;
+	bool m_bChecksum;
+	uint32_t m_uAdler;
+	ByteSink m_fnChecked; // Calls Write(), for RingBuffer::Flush()
+};
+
+binary_t PNGInflator::Decompress(const byte_t *compressedData, const size_t &size)
+{
+	SetInput(compressedData, size);
 	return DecompressData();
 }
 
-Binary PNGInflator::DecompressData()
+void PNGInflator::Decompress(const byte_t *compressedData, const size_t &size, const ByteSink &sink)
+{
+	SetInput(compressedData, size);
+	DecompressData(sink);
+}
+
+void PNGInflator::Decompress(const byte_t * compressedData, const size_t & size, byte_t * output, const size_t & outputSize)
+{
+	SetInput(compressedData, size);
+	DecompressData(output, outputSize);
+}
+
+binary_t PNGInflator::Decompress(ByteSource & source)
+{
+	SetInput(source);
+	return DecompressData();
+}
+
+void PNGInflator::Decompress(ByteSource & source, const ByteSink & sink)
+{
+	SetInput(source);
+	DecompressData(sink);
+}
+
+void PNGInflator::Decompress(ByteSource & source, byte_t * output, const size_t & outputSize)
+{
+	SetInput(source);
+	DecompressData(output, outputSize);
+}
+
+binary_t PNGInflator::DecompressData()
+{
+	binary_t data;
+	BufferOutput output(data, m_bChecksum);
+	InflateBlocks(output);
+	output.Finish();
+	ReadTrailer(output.Checksum());
+	return data;
+}
+
+void PNGInflator::DecompressData(byte_t * output, const size_t & outputSize)
+{
+	FixedOutput<false> out(output, outputSize, m_bChecksum);
+	InflateBlocks(out);
+	out.Finish();
+	ReadTrailer(out.Checksum());
+}
+
+void PNGInflator::DecompressPrefix(ByteSource & source, byte_t * output, const size_t & outputSize)
+{
+	SetInput(source);
+	FixedOutput<true> out(output, outputSize, false);
+	InflateBlocks(out);
+	out.Finish();
+}
+
+void PNGInflator::DecompressData(const ByteSink &sink)
+{
+	StreamOutput output(m_oLookback, sink, m_bChecksum);
+	InflateBlocks(output);
+	output.Finish();
+	ReadTrailer(output.Checksum());
+}
+
+void PNGInflator::SetInput(const byte_t *compressedData, const size_t &size)
+{
+	m_oLookback.Reset();
+	m_oData.SetData(compressedData, size);
+	ReadHeaders();
+}
+
+void PNGInflator::SetInput(ByteSource & source)
+{
+	m_oLookback.Reset();
+	m_oData.SetSource(&source);
+	ReadHeaders();
+}
+
+template <class Output>
+void PNGInflator::InflateBlocks(Output &output)
 {
 	bool BFINAL;
-	Binary data;
 
 	do {
 		// Read the chunk header
@@ -38,7 +316,8 @@ Binary PNGInflator::DecompressData()
 		{
 		case BType::UNCOMPRESSED:
 		{
-			std::cout << "Data is not compressed!\n";
+			if (m_bVerbose)
+				std::cout << "Data is not compressed!\n";
 			m_oData.FlushBits(); // Discarding the remaining unused bits in the byte
 
 			// Reading the LEN and NLEN fields
@@ -50,30 +329,35 @@ Binary PNGInflator::DecompressData()
 				throw "LEN field doesn't match the copliment of NLEN!";
 			}
 
-			// Extracting the data
-			binary_t vec(LEN);
-			m_oData.ReadData(vec.data(), LEN);
-			data.AppendData(vec);
+			// The first few bytes may already be in the bit buffer, the rest is passed to the output
+			// straight from the input segments(e.g. the mapped IDAT chunks) without copying it first
+			byte_t buffered[sizeof(uint64_t)];
+			size_t count = std::min((size_t)LEN, m_oData.BufferedBytes());
+			m_oData.ReadData(buffered, count);
+			output.Stored(buffered, count);
+			for (size_t left = LEN - count; left > 0 && !output.Full(); left -= count) {
+				const byte_t *data;
+				count = m_oData.ReadInPlace(data, left);
+				output.Stored(data, count);
+			}
 			break;
 		}
 		case BType::STATIC:
-			std::cout << "Data is compressed using static Huffman codes!\n";
-			data.AppendData(DecodeBlock(m_pLitDist));
+			if (m_bVerbose)
+				std::cout << "Data is compressed using static Huffman codes!\n";
+			DecodeBlock(m_oStaticLitLen, m_oStaticDist, output);
 			break;
 		case BType::DYNAMIC: {
-			std::cout << "Data is compressed using dynamic Huffman codes!\n";
-			TreePair codes = DecodeHuffmanCodes();
-			data.AppendData(DecodeBlock(codes));
-			FreeHuffmanTree(codes.first);
-			FreeHuffmanTree(codes.second);
+			if (m_bVerbose)
+				std::cout << "Data is compressed using dynamic Huffman codes!\n";
+			DecodeHuffmanCodes();
+			DecodeBlock(m_oDynamicLitLen, m_oDynamicDist, output);
 			break;
 		}
 		default:
-			std::cerr << "Unsupported BTYPE of " << (uint32_t)BTYPE << " found!\n";
-			exit(1);
+			throw "Unsupported BTYPE found!";
 		}
-	} while (!BFINAL);
-	return data;
+	} while (!BFINAL && !output.Full());
 }
 
 void PNGInflator::ReadHeaders()
@@ -82,21 +366,40 @@ void PNGInflator::ReadHeaders()
 	m_oData.ReadData((byte_t*)&header, sizeof(header));
 	FillCMF(header);
 	FillFLG(header);
+
+	if (m_stCompressionInfo.CM != CompressionMethod::DEFLATE)
+		throw "The zlib stream is not compressed with deflate(CM)!";
+	if (m_stCompressionInfo.CINFO > 7)
+		throw "The zlib window is larger than 32K(CINFO)!";
+	if (!m_stFlags.FCHECK)
+		throw "The zlib header is corrupted(FCHECK)!";
+	if (m_stFlags.FDICT)
+		throw "Preset dictionaries are not allowed in PNG!";
+}
+
+void PNGInflator::ReadTrailer(const uint32_t &adler)
+{
+	if (!m_bChecksum)
+		return;
+	// The Adler-32 of the decompressed data is stored after the last block in Network-byte-order (Big-Endian)
+	m_oData.FlushBits();
+	uint32_t trailer;
+	m_oData.ReadData((byte_t*)&trailer, sizeof(trailer));
+	if (Binary::ByteSwap(trailer) != adler)
+		throw "Adler-32 checksum mismatch!";
 }
 
 void PNGInflator::FillCMF(const ZLHeader &header)
 {
 	// CM
-	m_stCompressionInfo.CM = (header.CMF & (uint32_t)CompressionMethod::DEFLATE) ?
+	m_stCompressionInfo.CM = ((header.CMF & CM_MASK) == (uint32_t)CompressionMethod::DEFLATE) ?
 		CompressionMethod::DEFLATE :
 		CompressionMethod::UNKNOWN;
 
 	// CINFO
 	m_stCompressionInfo.CINFO = (uint32_t)(header.CMF & CINFO_MASK) >> 4;
-	if (m_stCompressionInfo.CINFO > 7) {
-		std::cout << "CINFO is " << m_stCompressionInfo.CINFO << ", while the maximum allowed value is 7!\n";
-		return;
-	}
+	if (m_stCompressionInfo.CINFO > 7)
+		return; // Rejected by ReadHeaders()
 	m_uWindowSize = (uint32_t)std::pow(2, m_stCompressionInfo.CINFO + 8);
 }
 
@@ -124,7 +427,7 @@ CompressionLevel PNGInflator::GetCompressionLevel(const ZLHeader &header)
 	return (CompressionLevel)level;
 }
 
-TreePair PNGInflator::DecodeHuffmanCodes()
+void PNGInflator::DecodeHuffmanCodes()
 {
 	// Reading the number of literal, distance and code length codes
 	uint32_t HLIT = m_oData.GetBits(5);
@@ -134,247 +437,95 @@ TreePair PNGInflator::DecodeHuffmanCodes()
 	HDIST += HDIST_OFFSET;
 	HCLEN += HCLEN_OFFSET;
 
-	// Filling the code lengths for the code length alphabet
-	LengthsSet clenLengths;
+	// Filling the code lengths for the code length alphabet, the missing ones are 0
+	uint8_t clenLengths[CLEN_LEN_COUNT] = {};
 	for (size_t i = 0; i < HCLEN; i++)
-	{
-		uint32_t length = m_oData.GetBits(3);
-		if (length > 0)
-			clenLengths.insert(std::make_pair(length, new Node(LengthsOrder[i])));
-	}
-
-	Node *lenTree = CreateHuffmanTree(clenLengths);
-	std::vector<uint32_t> lit_dist = ReadLiteralsAndDistances(lenTree, HLIT + HDIST);
-	FreeHuffmanTree(lenTree);
-	std::cout << "Read " << lit_dist.size() << " out of the " << HLIT + HDIST << " literal and distance symbols.\n";
-	
-	// Creating two separate vectors for the literal lengths and distance lengths
-	LengthsSet litLengths;
-	LengthsSet distLengths;
-
-	// Filling the literals LengthSet from the lit_dist vector
-	LenghtsSetFromRange(litLengths, lit_dist.begin(), lit_dist.begin() + HLIT);
-
-	// Filling the distances LengthSet from the lit_dist vector
-	LenghtsSetFromRange(distLengths, lit_dist.begin() + HLIT, lit_dist.end());
-	
-	// Creating the literal code tree
-	Node *litTree = CreateHuffmanTree(litLengths);
-
-	// Creating the distace code tree
-	Node *distTree;
-	if (distLengths.size() == 1) {
-		if (distLengths.begin()->first == 0) {
-			distTree = nullptr;
-		}
-		else if (distLengths.begin()->first == 1) {
-			distTree = new Node(new Node(DUMMY_CODE_VALUE), new Node(0));
-		}
-		else {
-			// ToDo: Handle cases where length > 1
-		}
-	}
-	else if(distLengths.size() > 1) {
-		distTree = CreateHuffmanTree(distLengths);
-	}
-	else {
-		// ToDo: Handle cases where size == 0
-	}
-
-	return std::make_pair(litTree, distTree);
-}
-
-Node* PNGInflator::CreateHuffmanTree(LengthsSet values)
-{
-	// Creating the Huffman tree using a multimap with key - the level of the node and value - the node data  
-	uint32_t currLevel = 0;
-	std::vector<Node*> tempNodes;
-
-	while (values.size() != 1 || !tempNodes.empty()) {
-		if (tempNodes.size() != 0 && currLevel != values.begin()->first)
-			throw "Can't construct Huffman tree from the given map!\n";
-		currLevel = values.begin()->first;
-
-		// Popping the first element from the map and putting it into the vector
-		tempNodes.push_back(values.begin()->second);
-		values.erase(values.begin());
-
-		if (tempNodes.size() == 2) {
-			// Creating new parent node from the 2 elements of the vector and putting it back in the map with lower level
-			values.insert(std::make_pair(currLevel - 1, new Node(tempNodes.at(0), tempNodes.at(1))));
-			tempNodes.erase(tempNodes.begin(), tempNodes.end());
-		}
-	}
-
-	return values.begin()->second;
+		clenLengths[LengthsOrder[i]] = (uint8_t)m_oData.GetBits(3);
+	m_oCodeLengths.Build(clenLengths, CLEN_LEN_COUNT, Alphabet::CODE_LENGTHS);
+	if (m_oCodeLengths.Empty())
+		throw "The code length alphabet contains no codes!";
+
+	// The literal/length and distance code lengths are read as a single sequence
+	ReadLiteralsAndDistances(m_oCodeLengths, HLIT + HDIST);
+	if (m_aCodeLengths[256] == 0)
+		throw "The block has no end-of-block code!";
+
+	// Converting the code lengths into lookup tables. The distance alphabet can be empty if the block has only literals
+	m_oDynamicLitLen.Build(m_aCodeLengths, HLIT, Alphabet::LITERALS);
+	m_oDynamicDist.Build(m_aCodeLengths + HLIT, HDIST, Alphabet::DISTANCES);
 }
 
-void PNGInflator::FreeHuffmanTree(Node * treeRoot)
+void PNGInflator::ReadLiteralsAndDistances(const HuffmanTable &codeTable, const uint32_t &count)
 {
-	if (treeRoot->left != nullptr)
-		FreeHuffmanTree(treeRoot->left);
-	if (treeRoot->right != nullptr)
-		FreeHuffmanTree(treeRoot->right);
-
-	delete treeRoot;
-	treeRoot = nullptr;
-}
-
-std::vector<uint32_t> PNGInflator::ReadLiteralsAndDistances(const Node* codeTree, uint32_t count)
-{
-	uint32_t repeatCount = 0;
-	uint32_t lastVal = UINT_MAX;
-	std::vector<uint32_t> lit_dist;
-	while (count)
+	uint32_t read = 0;
+	while (read < count)
 	{
-		if (repeatCount > 0) {
-			if (lastVal == UINT_MAX)
-				throw "Trying to repeat the last symbol while there is no symbols read!";
-			lit_dist.push_back(lastVal);
-			count--;
-			repeatCount--;
-			continue; // Skip the rest of the code
-		}
-
-		uint32_t symbol = DecodeSymbol(codeTree);
-		if (symbol >= 0 && symbol < 15) {
+		const HuffmanEntry &entry = codeTable.Decode(m_oData);
+		uint32_t symbol = entry.value;
+		uint8_t value = 0;
+		uint32_t repeatCount = 0;
+		if (symbol < 16) {
 			// This is a code length
-			lit_dist.push_back(symbol);
-			lastVal = symbol;
-			count--;
+			m_aCodeLengths[read++] = (uint8_t)symbol;
+			continue;
 		}
 		else if (symbol == 16) {
 			// Repeat the previous code length 3 - 6 times (size read from the next 2 bits)
-			repeatCount = m_oData.GetBits(2) + 3;
+			if (read == 0)
+				throw "Trying to repeat the last symbol while there is no symbols read!";
+			value = m_aCodeLengths[read - 1];
+			repeatCount = m_oData.GetBits(entry.extra) + 3;
 		}
 		else if (symbol == 17) {
 			// Put 3 - 10 zeros (size read from the next 3 bits)
-			lastVal = 0;
-			repeatCount = m_oData.GetBits(3) + 3;
+			repeatCount = m_oData.GetBits(entry.extra) + 3;
 		}
 		else if (symbol == 18) {
 			// Put 11 - 138 zeros (size read from the next 7 bits)
-			lastVal = 0;
-			repeatCount = m_oData.GetBits(7) + 11;
+			repeatCount = m_oData.GetBits(entry.extra) + 11;
 		}
 		else {
 			throw "Unexpected symbol found!";
 		}
+		if (repeatCount > count - read)
+			throw "Repeat count goes beyond the the provided size!";
+		memset(m_aCodeLengths + read, value, repeatCount);
+		read += repeatCount;
 	}
-	if (repeatCount > 0)
-		throw "Repeat count goes beyond the the provided size!";
-
-	return lit_dist;
-}
-
-uint32_t PNGInflator::DecodeSymbol(const Node* codeTree)
-{
-	const Node* currNode = codeTree;
-	while (currNode->left != nullptr && currNode->right != nullptr)
-	{
-		uint32_t bit = m_oData.GetBits(1);
-		if (bit) {
-			currNode = currNode->right;
-		}
-		else {
-			currNode = currNode->left;
-		}
-	}
-	return currNode->value;
 }
 
-uint32_t PNGInflator::DecodeLength(const uint32_t &symbol)
+template <class Output>
+void PNGInflator::DecodeBlock(const HuffmanTable &litLen, const HuffmanTable &dist, Output &output)
 {
-	if (symbol <= 256 || symbol > 285) {
-		std::cerr << "Invalid symbol for length(" << symbol << ")!\n";
-		exit(1);
-	}
-	if (symbol < 265) {
-		return symbol - 254; // This gives us the length
-	}
-	else if (symbol == 285) {
-		return 258;
-	}
-	else {
-		uint32_t extraBits = (symbol - (265 - 4)) / 4;
-		return ((((symbol - 265) % 4) + 4) << extraBits) + 3 + m_oData.GetBits(extraBits);
+	// While the current segment has at least 8 more bytes, a single refill gives enough bits for
+	// a length code, a distance code and their extra bits(at most 48), so the reads need no checks
+	// The loop also stops when only the beginning of the stream is needed and the output is full
+	bool more = true;
+	while (more) {
+		for (uint32_t i = 0; i < CHECKSUM_STEP_SYMBOLS && more; i++)
+			more = (m_oData.RefillFast() ? DecodeSymbol<true>(litLen, dist, output) : DecodeSymbol<false>(litLen, dist, output)) && !output.Full();
+		output.Step(); // Checksums the literals of the last symbols while they are in the cache
 	}
 }
 
-uint32_t PNGInflator::DecodeDistance(const uint32_t & symbol)
+template <bool Fast, class Output>
+bool PNGInflator::DecodeSymbol(const HuffmanTable &litLen, const HuffmanTable &dist, Output &output)
 {
-	if (symbol < 0 || symbol > 29) {
-		std::cerr << "Invalid symbol for distance(" << symbol << ")!\n";
-		exit(1);
+	// Reading symbol from the literal/length table
+	const HuffmanEntry &entry = Fast ? litLen.DecodeFast(m_oData) : litLen.Decode(m_oData);
+	if (entry.type == HuffmanSymbol::END_OF_BLOCK) {
+		return false;
 	}
-	if (symbol < 4) {
-		return symbol + 1;
+	else if (entry.type == HuffmanSymbol::LITERAL) { // Literal byte
+		output.Literal((byte_t)entry.value);
 	}
-	else {
-		uint32_t extraBits = (symbol - (4 - 2)) / 2;
-		return ((((symbol - 4) % 2) + 2) << extraBits) + 1 + m_oData.GetBits(extraBits);
+	else { // Offset distance and length
+		if (dist.Empty())
+			throw "Distance alphabet contains 0 entries, but a length symbol was found in the stream!";
+		uint32_t len = entry.value + (Fast ? m_oData.GetBitsFast(entry.extra) : m_oData.GetBits(entry.extra));
+		const HuffmanEntry &distEntry = Fast ? dist.DecodeFast(m_oData) : dist.Decode(m_oData); // Reading a symbol from the distance table
+		uint32_t distance = distEntry.value + (Fast ? m_oData.GetBitsFast(distEntry.extra) : m_oData.GetBits(distEntry.extra));
+		output.Match(distance, len); // Copying data from the lookback dictionary
 	}
-}
-
-Binary PNGInflator::DecodeBlock(const TreePair& alphabets)
-{
-	Binary data;
-	do
-	{
-		uint32_t sym = DecodeSymbol(alphabets.first); // Reading symbol from the literal/length tree
-		if (sym == 256) { // End of block
-			break;
-		}
-		else if(sym <= 255) { // Literal byte
-			data.AppendData((byte_t)sym);
-			m_oLookback.AppendByte((byte_t)sym);
-		}
-		else { // Offset distance and length
-			if (alphabets.second == nullptr) {
-				std::cerr << "Distance alphabet contains 0 entries, but symbol " << sym << " was found in the stream!\n";
-				exit(1);
-			}
-			uint32_t len = DecodeLength(sym);
-			if (len < 3 || len > 258) {
-				std::cerr << "Length is " << len << " while the valid range is 3 >= len <= 258!\n";
-				exit(1);
-			}
-			uint32_t distCode = DecodeSymbol(alphabets.second); // Reading a symbol from the distance tree
-			uint32_t dist = DecodeDistance(distCode); // Parsing the read symbol
-			m_oLookback.WriteToObject(dist, len, data); // Copying data from the lookback dictionary
-		}
-	} while (true);
-	return data;
-}
-
-Node * PNGInflator::GenerateStaticLitLen()
-{
-	std::vector<uint32_t> temp(288);
-	std::fill(temp.begin(), temp.begin() + 144, 8); // Elements 0-143 have value of 8
-	std::fill(temp.begin() + 144, temp.begin() + 256, 9); // Elements 144-255 have value of 9
-	std::fill(temp.begin() + 256, temp.begin() + 280, 7); // Elements 256-279 have value of 7
-	std::fill(temp.begin() + 280, temp.end(), 8); // Elements 280-287 have value of 8
-	LengthsSet litLen;
-	LenghtsSetFromRange(litLen, temp.begin(), temp.end());
-	return CreateHuffmanTree(litLen);
-}
-
-Node * PNGInflator::GenerateStaticDist()
-{
-	std::vector<uint32_t> temp(32, 5); // Vector of 32 elemnts with value 5
-	LengthsSet distLen;
-	LenghtsSetFromRange(distLen, temp.begin(), temp.end());
-	return CreateHuffmanTree(distLen);
-}
-
-void PNGInflator::LenghtsSetFromRange(LengthsSet &set, const std::vector<uint32_t>::iterator &begin, const std::vector<uint32_t>::iterator &end)
-{
-	uint32_t index = 0;
-	std::transform(begin, end, std::inserter(set, set.begin()), [&index](const uint32_t& len) {
-		return std::make_pair(len, new Node(index++));
-	});
-
-	// Remove zero lenghts
-	while (set.rbegin()->first == 0)
-		set.erase(--(set.end()));
+	return true;
 }
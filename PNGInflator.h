@@ -1,10 +1,11 @@
 #pragma once
 #include <Binary.h>
 #include <iostream>
-#include <set>
-#include <algorithm> // used for std::transform() and std::fill()
-#include <iterator> // used for std::inserter()
+#include <algorithm> // used for std::min() and std::max()
 #include "RingBuffer.h"
+#include "BitReader.h"
+#include "HuffmanTable.h"
+#include "Adler32.h"
 
 #define CM_MASK 0x0F
 #define CINFO_MASK 0xF0
@@ -18,48 +19,12 @@
 
 #define CLEN_LEN_COUNT 19
 
-#define DUMMY_CODE_VALUE UINT32_MAX
-
+#define STREAM_FLUSH_SIZE (16 * 1024) // How much decompressed data is collected before passing it to the sink in streaming mode
+#define CHECKSUM_STEP_SYMBOLS 4096 // The Adler-32 of the literals is updated after each group of this many symbols
 
 extern uint32_t LengthsOrder[19];
 
 
-struct Node {
-	Node(uint32_t val) : value(val), depth(0), left(nullptr), right(nullptr) {}
-	Node() : Node(0) {}
-	Node(Node* l, Node* r) :value(l->value + r->value), depth(std::max(l->depth, r->depth) + 1), left(l), right(r) {}
-	const uint32_t value;
-	const uint32_t depth;
-	Node* left;
-	Node* right;
-};
-
-typedef std::pair<uint32_t, Node*> LengthPair;
-typedef std::pair<Node*, Node*> TreePair;
-
-struct greater_node {
-	bool operator() (const LengthPair& lhs, const LengthPair& rhs) const
-	{
-		if (lhs.first > rhs.first)
-			return true;
-		else if (lhs.first == rhs.first)
-		{
-			// Assuming that both the left and the right branch are either nullptr or pointer to Node
-			if (lhs.second->left == nullptr && rhs.second->left != nullptr) // Left is leaf and right is branch
-				return true;
-			else if (lhs.second->left != nullptr && rhs.second->left == nullptr) // Left is branch and right is leaf
-				return false;
-			else if (lhs.second->left != nullptr && rhs.second->left != nullptr) // Both are branches
-				return (lhs.second->depth < rhs.second->depth);
-			else if (lhs.second->value < rhs.second->value) // Both are leafs
-				return true;
-		}
-		return false;
-	}
-};
-
-typedef std::multiset<LengthPair, greater_node> LengthsSet;
-
 enum class CompressionMethod {
 	UNKNOWN = -1,
 	DEFLATE = 0x08,
@@ -105,32 +70,64 @@ public:
 	PNGInflator();
 	~PNGInflator();
 
-	Binary Decompress(Binary compressedData);
-	Binary DecompressData();
+	// The compressed data is read in place and must stay valid during the call
+	binary_t Decompress(const byte_t *compressedData, const size_t &size);
+	// Streaming mode, the decompressed data is passed to the sink in parts as it is produced
+	void Decompress(const byte_t *compressedData, const size_t &size, const ByteSink &sink);
+	// Decompresses in a buffer owned by the caller. The stream must fill the buffer exactly, otherwise an exception is thrown
+	void Decompress(const byte_t *compressedData, const size_t &size, byte_t *output, const size_t &outputSize);
+	// The compressed data is requested from the source in parts while decompressing
+	binary_t Decompress(ByteSource &source);
+	void Decompress(ByteSource &source, const ByteSink &sink);
+	void Decompress(ByteSource &source, byte_t *output, const size_t &outputSize);
+	// Decompresses only the first "outputSize" bytes of the stream. The rest of it is never read, so its
+	// checksum is not verified. Throws if the stream is shorter
+	void DecompressPrefix(ByteSource &source, byte_t *output, const size_t &outputSize);
+	binary_t DecompressData();
+	void DecompressData(const ByteSink &sink);
+	void DecompressData(byte_t *output, const size_t &outputSize);
+	// Checks the Adler-32 at the end of the stream(the default). When disabled the trailer is not read at all
+	void SetChecksum(const bool &enable) { m_bChecksum = enable; }
+	// The type of each block is printed to std::cout only if verbose(the default)
+	void SetVerbose(const bool &verbose) { m_bVerbose = verbose; }
 
 private: // Methods
+	void SetInput(const byte_t *compressedData, const size_t &size);
+	void SetInput(ByteSource &source);
+	template <class Output>
+	void InflateBlocks(Output &output);
+	// Reads the zlib header, throws if it is not valid for PNG
 	void ReadHeaders();
+	// Reads the Adler-32 at the end of the stream and compares it with the one of the decompressed data
+	void ReadTrailer(const uint32_t &adler);
 	void FillCMF(const ZLHeader &header);
 	void FillFLG(const ZLHeader &header);
 	bool FCheckResult(const ZLHeader &header);
 	CompressionLevel GetCompressionLevel(const ZLHeader &header);
-	TreePair DecodeHuffmanCodes();
-	Node* CreateHuffmanTree(LengthsSet values);
-	void FreeHuffmanTree(Node* treeRoot);
-	std::vector<uint32_t> ReadLiteralsAndDistances(const Node* codeTree, uint32_t count);
-	uint32_t DecodeSymbol(const Node* codeTree);
-	uint32_t DecodeLength(const uint32_t &symbol);
-	uint32_t DecodeDistance(const uint32_t &symbol);
-	Binary DecodeBlock(const TreePair &alphabets);
-	Node* GenerateStaticLitLen();
-	Node* GenerateStaticDist();
-	void LenghtsSetFromRange(LengthsSet &set, const std::vector<uint32_t>::iterator &begin, const std::vector<uint32_t>::iterator &end);
+	void DecodeHuffmanCodes();
+	// Fills m_aCodeLengths with "count" code lengths
+	void ReadLiteralsAndDistances(const HuffmanTable &codeTable, const uint32_t &count);
+	template <class Output>
+	void DecodeBlock(const HuffmanTable &litLen, const HuffmanTable &dist, Output &output);
+	// Decodes a literal or a length/distance pair, returns false at the end of the block
+	template <bool Fast, class Output>
+	bool DecodeSymbol(const HuffmanTable &litLen, const HuffmanTable &dist, Output &output);
 
 private: // Variables
 	ZLCMF m_stCompressionInfo;
 	ZLFLG m_stFlags;
 	uint32_t m_uWindowSize;
-	Binary m_oData;
-	TreePair m_pLitDist;
-	RingBuffer m_oLookback;
+	RingBuffer m_oLookback; // Used only in streaming mode
+	BitReader m_oData;
+	HuffmanTable m_oStaticLitLen;
+	HuffmanTable m_oStaticDist;
+	// The dynamic tables are rebuilt in place for every block in fixed parts of m_aTableArena, which is sized for the
+	// largest possible tables, so no block allocates memory
+	HuffmanEntry m_aTableArena[CLEN_TABLE_SIZE + LITLEN_TABLE_SIZE + DIST_TABLE_SIZE];
+	HuffmanTable m_oCodeLengths;
+	HuffmanTable m_oDynamicLitLen;
+	HuffmanTable m_oDynamicDist;
+	uint8_t m_aCodeLengths[FIXED_LITLEN_COUNT + FIXED_DIST_COUNT]; // The code lengths of the current dynamic block
+	bool m_bChecksum;
+	bool m_bVerbose;
 };
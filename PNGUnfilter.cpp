@@ -0,0 +1,348 @@
+#include "PNGUnfilter.h"
+#include <cstring> // used for memcpy()
+#include <cstdlib> // used for abs()
+
+#ifdef PNG_X86
+#include <immintrin.h>
+#endif
+
+//  For more info about the filters: https://www.w3.org/TR/2003/REC-PNG-20031110/#9Filters
+//  In the comments below "a" is the byte in the left pixel, "b" the byte above and "c" the byte above "a"
+
+static void NoneScalar(byte_t *, const byte_t *, const size_t &, const size_t &)
+{
+}
+
+// The scalar kernels are compiled for each pixel size PNG uses(1, 2, 3, 4, 6 and 8 bytes), so the loops
+// can be unrolled. "N" is 0 in the generic versions, which use the pixel size given at runtime
+template <size_t N>
+static void SubScalar(byte_t *row, const byte_t *, const size_t &rowBytes, const size_t &pixelSize)
+{
+	const size_t step = N ? N : pixelSize;
+	for (size_t i = step; i < rowBytes; i++)
+		row[i] += row[i - step];
+}
+
+static void UpScalar(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	for (size_t i = 0; i < rowBytes; i++)
+		row[i] += previous[i];
+}
+
+template <size_t N>
+static void AverageScalar(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &pixelSize)
+{
+	const size_t step = N ? N : pixelSize;
+	// The leftmost pixel has no "a", so only half of "b" is added
+	for (size_t i = 0; i < step && i < rowBytes; i++)
+		row[i] += previous[i] / 2;
+	for (size_t i = step; i < rowBytes; i++)
+		row[i] += (byte_t)(((uint32_t)row[i - step] + (uint32_t)previous[i]) / 2); // Make sure to prevent integer overflow
+}
+
+static inline byte_t PaethPredictor(const int &a, const int &b, const int &c)
+{
+	// Using signed int to prevent under or overflow
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	return (byte_t)((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c);
+}
+
+template <size_t N>
+static void PaethScalar(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &pixelSize)
+{
+	const size_t step = N ? N : pixelSize;
+	// With "a" and "c" being 0 the predictor always picks "b" for the leftmost pixel
+	for (size_t i = 0; i < step && i < rowBytes; i++)
+		row[i] += previous[i];
+	for (size_t i = step; i < rowBytes; i++)
+		row[i] += PaethPredictor(row[i - step], previous[i], previous[i - step]);
+}
+
+template <size_t N>
+static void SetScalarKernels(UnfilterRowFunction kernels[5])
+{
+	kernels[(int)FilterType::NONE] = NoneScalar;
+	kernels[(int)FilterType::SUB] = SubScalar<N>;
+	kernels[(int)FilterType::UP] = UpScalar;
+	kernels[(int)FilterType::AVERAGE] = AverageScalar<N>;
+	kernels[(int)FilterType::PAETH] = PaethScalar<N>;
+}
+
+#ifdef PNG_X86
+// Single pixel loads and stores. A 3 byte pixel is loaded as 4 bytes, the extra byte is ignored
+TARGET_SSE2 static inline __m128i LoadPixel(const byte_t *p)
+{
+	int32_t value;
+	memcpy(&value, p, sizeof(value));
+	return _mm_cvtsi32_si128(value);
+}
+
+template <size_t PixelSize>
+TARGET_SSE2 static inline void StorePixel(byte_t *p, const __m128i &pixel)
+{
+	int32_t value = _mm_cvtsi128_si32(pixel);
+	memcpy(p, &value, PixelSize);
+}
+
+TARGET_SSE2 static void UpSSE2(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	size_t i = 0;
+	for (; i + 16 <= rowBytes; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(previous + i));
+		_mm_storeu_si128((__m128i*)(row + i), _mm_add_epi8(x, b));
+	}
+	for (; i < rowBytes; i++)
+		row[i] += previous[i];
+}
+
+TARGET_SSE2 static void Sub4SSE2(byte_t *row, const byte_t *, const size_t &rowBytes, const size_t &)
+{
+	// Prefix sum of the 4 pixels in a vector, plus the last reconstructed pixel broadcasted in "a"
+	__m128i a = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= rowBytes; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi8(x, a);
+		_mm_storeu_si128((__m128i*)(row + i), x);
+		a = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	for (; i < rowBytes; i += 4) {
+		a = _mm_add_epi8(LoadPixel(row + i), a);
+		StorePixel<4>(row + i, a);
+	}
+}
+
+TARGET_SSE2 static void Sub3SSE2(byte_t *row, const byte_t *, const size_t &rowBytes, const size_t &)
+{
+	// Same as Sub4SSE2, but with 4 pixels(12 bytes) per vector. The last 4 bytes of the vector are never stored
+	const __m128i pixelMask = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0);
+	__m128i a = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 12 <= rowBytes; i += 12) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+		x = _mm_add_epi8(x, a);
+		_mm_storel_epi64((__m128i*)(row + i), x);
+		StorePixel<4>(row + i + 8, _mm_srli_si128(x, 8));
+
+		// Replicating the last pixel in bytes 0-11
+		a = _mm_and_si128(_mm_srli_si128(x, 9), pixelMask);
+		a = _mm_or_si128(a, _mm_slli_si128(a, 3));
+		a = _mm_or_si128(a, _mm_slli_si128(a, 6));
+	}
+	for (; i < rowBytes; i += 3) {
+		a = _mm_add_epi8(LoadPixel(row + i), a);
+		StorePixel<3>(row + i, a);
+	}
+}
+
+template <size_t PixelSize>
+TARGET_SSE2 static void AverageSSE2(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	// _mm_avg_epu8 rounds up, so 1 is subtracted when a + b is odd
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	for (size_t i = 0; i < rowBytes; i += PixelSize) {
+		__m128i b = LoadPixel(previous + i);
+		__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(LoadPixel(row + i), avg);
+		StorePixel<PixelSize>(row + i, a);
+	}
+}
+
+template <size_t PixelSize>
+TARGET_SSE2 static void PaethSSE2(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	// The math is done on 16-bit lanes. Starting with "b" and "d" set to 0, which become "c" and "a" for the first pixel
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, b = zero, c, d = zero;
+	for (size_t i = 0; i < rowBytes; i += PixelSize) {
+		c = b;
+		b = _mm_unpacklo_epi8(LoadPixel(previous + i), zero);
+		a = d;
+		d = _mm_unpacklo_epi8(LoadPixel(row + i), zero);
+
+		// p - a = b - c, p - b = a - c and p - c = (b - c) + (a - c)
+		__m128i pa = _mm_sub_epi16(b, c);
+		__m128i pb = _mm_sub_epi16(a, c);
+		__m128i pc = _mm_add_epi16(pa, pb);
+		pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+		// Ties are broken in favor of "a", then "b" and then "c"
+		__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+		__m128i useA = _mm_cmpeq_epi16(smallest, pa);
+		__m128i useB = _mm_cmpeq_epi16(smallest, pb);
+		__m128i nearest = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+		nearest = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, nearest));
+
+		// Adding as bytes so the result wraps around 256 and the high bytes stay 0
+		d = _mm_add_epi8(d, nearest);
+		StorePixel<PixelSize>(row + i, _mm_packus_epi16(d, d));
+	}
+}
+
+TARGET_SSE41 static void Sub3SSE41(byte_t *row, const byte_t *, const size_t &rowBytes, const size_t &)
+{
+	// Same as Sub3SSE2, but the last pixel is replicated with a single shuffle
+	const __m128i lastPixel = _mm_setr_epi8(9, 10, 11, 9, 10, 11, 9, 10, 11, 9, 10, 11, -1, -1, -1, -1);
+	__m128i a = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 12 <= rowBytes; i += 12) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+		x = _mm_add_epi8(x, a);
+		_mm_storel_epi64((__m128i*)(row + i), x);
+		StorePixel<4>(row + i + 8, _mm_srli_si128(x, 8));
+		a = _mm_shuffle_epi8(x, lastPixel);
+	}
+	for (; i < rowBytes; i += 3) {
+		a = _mm_add_epi8(LoadPixel(row + i), a);
+		StorePixel<3>(row + i, a);
+	}
+}
+
+template <size_t PixelSize>
+TARGET_SSE41 static void PaethSSE41(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	// Same as PaethSSE2, but using the SSSE3 abs and the SSE4.1 blend instructions
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, b = zero, c, d = zero;
+	for (size_t i = 0; i < rowBytes; i += PixelSize) {
+		c = b;
+		b = _mm_cvtepu8_epi16(LoadPixel(previous + i));
+		a = d;
+		d = _mm_cvtepu8_epi16(LoadPixel(row + i));
+
+		__m128i pa = _mm_sub_epi16(b, c);
+		__m128i pb = _mm_sub_epi16(a, c);
+		__m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+		pa = _mm_abs_epi16(pa);
+		pb = _mm_abs_epi16(pb);
+
+		__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+		__m128i nearest = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(smallest, pb));
+		nearest = _mm_blendv_epi8(nearest, a, _mm_cmpeq_epi16(smallest, pa));
+
+		d = _mm_add_epi8(d, nearest);
+		StorePixel<PixelSize>(row + i, _mm_packus_epi16(d, d));
+	}
+}
+
+TARGET_AVX2 static void UpAVX2(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &)
+{
+	size_t i = 0;
+	for (; i + 32 <= rowBytes; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(row + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(previous + i));
+		_mm256_storeu_si256((__m256i*)(row + i), _mm256_add_epi8(x, b));
+	}
+	for (; i < rowBytes; i++)
+		row[i] += previous[i];
+}
+
+TARGET_AVX2 static void Sub4AVX2(byte_t *row, const byte_t *, const size_t &rowBytes, const size_t &)
+{
+	// The byte shifts work on each 128-bit lane separately, so the last pixel of the low lane is added to the high lane afterwards
+	const __m256i lastPixel = _mm256_set1_epi32(7);
+	__m256i a = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= rowBytes; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(row + i));
+		x = _mm256_add_epi8(x, _mm256_slli_si256(x, 4));
+		x = _mm256_add_epi8(x, _mm256_slli_si256(x, 8));
+		__m256i carry = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+		carry = _mm256_permute2x128_si256(carry, carry, 0x08); // Low lane is zeroed, high lane gets the low lane
+		x = _mm256_add_epi8(x, carry);
+		x = _mm256_add_epi8(x, a);
+		_mm256_storeu_si256((__m256i*)(row + i), x);
+		a = _mm256_permutevar8x32_epi32(x, lastPixel);
+	}
+	__m128i last = _mm256_castsi256_si128(a);
+	for (; i < rowBytes; i += 4) {
+		last = _mm_add_epi8(LoadPixel(row + i), last);
+		StorePixel<4>(row + i, last);
+	}
+}
+#endif
+
+PNGUnfilter::PNGUnfilter(const size_t & pixelSize, const InstructionSet & limit)
+	: m_uPixelSize(pixelSize), m_eInstructionSet(InstructionSet::SCALAR)
+{
+	switch (pixelSize)
+	{
+	case 1: SetScalarKernels<1>(m_pKernels); break;
+	case 2: SetScalarKernels<2>(m_pKernels); break;
+	case 3: SetScalarKernels<3>(m_pKernels); break;
+	case 4: SetScalarKernels<4>(m_pKernels); break;
+	case 6: SetScalarKernels<6>(m_pKernels); break;
+	case 8: SetScalarKernels<8>(m_pKernels); break;
+	default: SetScalarKernels<0>(m_pKernels); break;
+	}
+
+#ifdef PNG_X86
+	m_eInstructionSet = ::GetInstructionSet(limit);
+
+	// Avg and Paeth depend on the pixel to the left, so they are done one pixel at a time
+	// and a wider vector doesn't help them. The AVX2 level reuses their SSE4.1 versions.
+	switch (m_eInstructionSet)
+	{
+	case InstructionSet::AVX2:
+		m_pKernels[(int)FilterType::UP] = UpAVX2;
+		if (pixelSize == 4) {
+			m_pKernels[(int)FilterType::SUB] = Sub4AVX2;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<4>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE41<4>;
+		}
+		else if (pixelSize == 3) {
+			m_pKernels[(int)FilterType::SUB] = Sub3SSE41;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<3>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE41<3>;
+		}
+		break;
+	case InstructionSet::SSE41:
+		m_pKernels[(int)FilterType::UP] = UpSSE2;
+		if (pixelSize == 4) {
+			m_pKernels[(int)FilterType::SUB] = Sub4SSE2;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<4>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE41<4>;
+		}
+		else if (pixelSize == 3) {
+			m_pKernels[(int)FilterType::SUB] = Sub3SSE41;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<3>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE41<3>;
+		}
+		break;
+	case InstructionSet::SSE2:
+		m_pKernels[(int)FilterType::UP] = UpSSE2;
+		if (pixelSize == 4) {
+			m_pKernels[(int)FilterType::SUB] = Sub4SSE2;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<4>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE2<4>;
+		}
+		else if (pixelSize == 3) {
+			m_pKernels[(int)FilterType::SUB] = Sub3SSE2;
+			m_pKernels[(int)FilterType::AVERAGE] = AverageSSE2<3>;
+			m_pKernels[(int)FilterType::PAETH] = PaethSSE2<3>;
+		}
+		break;
+	default:
+		break;
+	}
+#else
+	(void)limit;
+#endif
+}
+
+PNGUnfilter::~PNGUnfilter()
+{
+}
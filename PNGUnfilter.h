@@ -0,0 +1,43 @@
+#pragma once
+#include <Binary.h>
+#include "CPUFeatures.h"
+
+#define UNFILTER_PADDING 16 // The SIMD kernels may read(but never write) up to this many bytes past the end of a row
+
+enum class FilterType {
+	NONE = 0,
+	SUB = 1,
+	UP = 2,
+	AVERAGE = 3,
+	PAETH = 4
+};
+
+// Reconstructs a whole row in place. "previous" is the already reconstructed row above(or a row of zeros)
+typedef void(*UnfilterRowFunction)(byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &pixelSize);
+
+
+// Reverses the PNG filters one row at a time. The kernels are selected once in the constructor
+// from the pixel size and the instruction sets supported by the CPU. There are SSE2, SSSE3/SSE4.1
+// and AVX2 kernels for 3 and 4 byte pixels, every other pixel size uses the scalar code, which is
+// compiled separately for each pixel size.
+class PNGUnfilter
+{
+public:
+	PNGUnfilter(const size_t &pixelSize, const InstructionSet &limit = InstructionSet::AVX2);
+	~PNGUnfilter();
+
+	inline void UnfilterRow(const byte_t &filter, byte_t *row, const byte_t *previous, const size_t &rowBytes) const;
+	InstructionSet GetInstructionSet() const { return m_eInstructionSet; }
+
+private: // Variables
+	UnfilterRowFunction m_pKernels[5];
+	size_t m_uPixelSize;
+	InstructionSet m_eInstructionSet;
+};
+
+inline void PNGUnfilter::UnfilterRow(const byte_t &filter, byte_t *row, const byte_t *previous, const size_t &rowBytes) const
+{
+	if (filter > (byte_t)FilterType::PAETH)
+		throw "Invalid filter found!";
+	m_pKernels[filter](row, previous, rowBytes, m_uPixelSize);
+}
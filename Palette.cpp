@@ -0,0 +1,194 @@
+#include "Palette.h"
+#include "CPUFeatures.h"
+#include <cstring> // used for memcpy()
+
+#ifdef PNG_X86
+#include <immintrin.h>
+#endif
+
+#define OPAQUE_BLACK 0xFF000000 // Alpha in the last byte(assuming a little-endian CPU)
+
+template <uint32_t BitDepth>
+static void UnpackIndices(const byte_t *packed, byte_t *indices, const size_t &width)
+{
+	const uint32_t perByte = 8 / BitDepth;
+	const uint32_t mask = (1u << BitDepth) - 1;
+	size_t x = 0;
+	for (; x + perByte <= width; x += perByte) {
+		byte_t bits = *packed++;
+		for (uint32_t i = 0; i < perByte; i++)
+			indices[x + i] = (byte_t)((bits >> (8 - BitDepth * (i + 1))) & mask);
+	}
+	for (size_t i = 0; x < width; x++, i++)
+		indices[x] = (byte_t)ReadSample<BitDepth>(packed, i);
+}
+
+template <bool Alpha>
+static void ExpandScalar(const byte_t *indices, byte_t *output, const size_t &width, const uint32_t *colors, const byte_t *)
+{
+	if (Alpha) {
+		for (size_t x = 0; x < width; x++)
+			memcpy(output + 4 * x, &colors[indices[x]], 4);
+		return;
+	}
+	// Every pixel is written with 4 bytes, the last one is overwritten by the next pixel
+	size_t x = 0;
+	for (; x + 1 < width; x++)
+		memcpy(output + 3 * x, &colors[indices[x]], 4);
+	if (x < width)
+		memcpy(output + 3 * x, &colors[indices[x]], 3);
+}
+
+#ifdef PNG_X86
+// Looks up 16 indices below 16 in each channel and interleaves the channels
+template <bool Alpha>
+TARGET_SSE41 static void ExpandShuffleSSSE3(const byte_t *indices, byte_t *output, const size_t &width, const uint32_t *colors, const byte_t *planes)
+{
+	const __m128i red = _mm_load_si128((const __m128i*)planes);
+	const __m128i green = _mm_load_si128((const __m128i*)(planes + SHUFFLE_PALETTE_SIZE));
+	const __m128i blue = _mm_load_si128((const __m128i*)(planes + 2 * SHUFFLE_PALETTE_SIZE));
+	const __m128i alpha = _mm_load_si128((const __m128i*)(planes + 3 * SHUFFLE_PALETTE_SIZE));
+	const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	// The RGB stores write 4 bytes more than the 12 of each 4 pixels, so 2 pixels after the block must be left for them
+	size_t x = 0;
+	for (; x + 16 + (Alpha ? 0 : 2) <= width; x += 16) {
+		__m128i index = _mm_loadu_si128((const __m128i*)(indices + x));
+		__m128i r = _mm_shuffle_epi8(red, index);
+		__m128i g = _mm_shuffle_epi8(green, index);
+		__m128i b = _mm_shuffle_epi8(blue, index);
+		__m128i a = _mm_shuffle_epi8(alpha, index);
+		__m128i rgLow = _mm_unpacklo_epi8(r, g);
+		__m128i rgHigh = _mm_unpackhi_epi8(r, g);
+		__m128i baLow = _mm_unpacklo_epi8(b, a);
+		__m128i baHigh = _mm_unpackhi_epi8(b, a);
+		__m128i pixels[4] = {
+			_mm_unpacklo_epi16(rgLow, baLow), _mm_unpackhi_epi16(rgLow, baLow),
+			_mm_unpacklo_epi16(rgHigh, baHigh), _mm_unpackhi_epi16(rgHigh, baHigh)
+		};
+		for (int i = 0; i < 4; i++) {
+			if (Alpha)
+				_mm_storeu_si128((__m128i*)(output + 4 * x + 16 * i), pixels[i]);
+			else
+				_mm_storeu_si128((__m128i*)(output + 3 * x + 12 * i), _mm_shuffle_epi8(pixels[i], dropAlpha));
+		}
+	}
+	ExpandScalar<Alpha>(indices + x, output + (Alpha ? 4 : 3) * x, width - x, colors, planes);
+}
+
+// Loads 8 palette entries with a single gather
+template <bool Alpha>
+TARGET_AVX2 static void ExpandGatherAVX2(const byte_t *indices, byte_t *output, const size_t &width, const uint32_t *colors, const byte_t *planes)
+{
+	const __m256i dropAlpha = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	size_t x = 0;
+	for (; x + 8 + (Alpha ? 0 : 2) <= width; x += 8) {
+		__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(indices + x)));
+		__m256i pixels = _mm256_i32gather_epi32((const int*)colors, index, 4);
+		if (Alpha) {
+			_mm256_storeu_si256((__m256i*)(output + 4 * x), pixels);
+		}
+		else {
+			pixels = _mm256_shuffle_epi8(pixels, dropAlpha);
+			_mm_storeu_si128((__m128i*)(output + 3 * x), _mm256_castsi256_si128(pixels));
+			_mm_storeu_si128((__m128i*)(output + 3 * x + 12), _mm256_extracti128_si256(pixels, 1));
+		}
+	}
+	ExpandScalar<Alpha>(indices + x, output + (Alpha ? 4 : 3) * x, width - x, colors, planes);
+}
+#endif
+
+Palette::Palette()
+	: m_uCount(0), m_bAlpha(false), m_uWidth(0), m_fnExpand(nullptr), m_fnUnpack(nullptr)
+{
+	Reset();
+}
+
+Palette::~Palette()
+{
+}
+
+void Palette::Reset()
+{
+	for (size_t i = 0; i < PALETTE_SIZE; i++)
+		m_aColors[i] = OPAQUE_BLACK;
+	m_uCount = 0;
+	m_bAlpha = false;
+}
+
+void Palette::SetColors(const byte_t * data, const size_t & size)
+{
+	if (size == 0 || size % 3 != 0 || size / 3 > PALETTE_SIZE)
+		throw "Invalid PLTE chunk size!";
+	m_uCount = (uint32_t)(size / 3);
+	for (size_t i = 0; i < m_uCount; i++) {
+		byte_t color[4] = { data[3 * i], data[3 * i + 1], data[3 * i + 2], UINT8_MAX };
+		memcpy(&m_aColors[i], color, sizeof(color));
+	}
+}
+
+void Palette::SetAlpha(const byte_t * data, const size_t & size)
+{
+	if (Empty())
+		throw "tRNS chunk found before the PLTE chunk!";
+	// Extra values are ignored
+	for (size_t i = 0; i < size && i < m_uCount; i++)
+		((byte_t*)&m_aColors[i])[3] = data[i];
+	m_bAlpha = true;
+}
+
+void Palette::ConvertColors(const OutputFormat & format)
+{
+	if (!PixelConverter::IsFourChannel(format))
+		return;
+	PixelConverter converter;
+	converter.Prepare({ 4, 8 }, format);
+	if (!converter.IsIdentity())
+		converter.ConvertRow((const byte_t*)m_aColors, (byte_t*)m_aColors, PALETTE_SIZE);
+	m_bAlpha = true;
+}
+
+void Palette::Prepare(const uint32_t & bitDepth, const uint32_t & width)
+{
+	m_uWidth = width;
+	for (size_t i = 0; i < SHUFFLE_PALETTE_SIZE; i++) {
+		for (size_t channel = 0; channel < 4; channel++)
+			m_aPlanes[channel * SHUFFLE_PALETTE_SIZE + i] = ((const byte_t*)&m_aColors[i])[channel];
+	}
+
+	m_fnExpand = m_bAlpha ? ExpandScalar<true> : ExpandScalar<false>;
+	switch (bitDepth)
+	{
+	case 1: m_fnUnpack = UnpackIndices<1>; break;
+	case 2: m_fnUnpack = UnpackIndices<2>; break;
+	case 4: m_fnUnpack = UnpackIndices<4>; break;
+	default: m_fnUnpack = nullptr; break;
+	}
+	if (m_fnUnpack != nullptr && m_vIndices.size() < width)
+		m_vIndices.resize(width);
+
+#ifdef PNG_X86
+	// The sub-byte indices are always below 16, so they can use the shuffle
+	InstructionSet instructionSet = GetInstructionSet();
+	if (bitDepth < 8 && instructionSet >= InstructionSet::SSE41)
+		m_fnExpand = m_bAlpha ? ExpandShuffleSSSE3<true> : ExpandShuffleSSSE3<false>;
+	else if (bitDepth == 8 && instructionSet == InstructionSet::AVX2)
+		m_fnExpand = m_bAlpha ? ExpandGatherAVX2<true> : ExpandGatherAVX2<false>;
+#endif
+}
+
+void Palette::ExpandRow(const byte_t * row, byte_t * output)
+{
+	ExpandRow(row, output, m_uWidth, m_vIndices.data());
+}
+
+void Palette::ExpandRow(const byte_t * row, byte_t * output, const uint32_t & width, byte_t * indices) const
+{
+	if (m_fnUnpack != nullptr) {
+		m_fnUnpack(row, indices, width);
+		row = indices;
+	}
+	m_fnExpand(row, output, width, m_aColors, m_aPlanes);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <Binary.h>
+#include "Image.h"
+#include "PixelConverter.h"
+
+#define PALETTE_SIZE 256
+#define SHUFFLE_PALETTE_SIZE 16 // Entries that fit in one SSE register per channel
+
+// Converts a row of "width" palette indices(8 bits each) to RGB8 or RGBA8. "colors" has PALETTE_SIZE RGBA entries and
+// "planes" the first SHUFFLE_PALETTE_SIZE entries split in 4 arrays, one per channel
+typedef void(*ExpandRowFunction)(const byte_t *indices, byte_t *output, const size_t &width, const uint32_t *colors, const byte_t *planes);
+// Unpacks a row of 1, 2 or 4-bit indices to one index per byte
+typedef void(*UnpackRowFunction)(const byte_t *packed, byte_t *indices, const size_t &width);
+
+
+// Color table of an indexed image, built from the PLTE and tRNS chunks. The rows are expanded using an AVX2
+// gather for 8-bit indices and a SSSE3 shuffle for the 1, 2 and 4-bit ones, which are unpacked first. The
+// kernels are selected once per image in Prepare().
+class Palette
+{
+public:
+	Palette();
+	~Palette();
+
+	void Reset();
+	// Reads the entries of a PLTE chunk, throws if its size is not valid
+	void SetColors(const byte_t *data, const size_t &size);
+	// Reads the alpha values of a tRNS chunk. Entries without a value stay opaque
+	void SetAlpha(const byte_t *data, const size_t &size);
+	bool Empty() const { return m_uCount == 0; }
+	bool HasAlpha() const { return m_bAlpha; }
+	// RGBA8 if the palette has a tRNS chunk, RGB8 otherwise
+	SampleFormat GetOutputFormat() const { return { m_bAlpha ? 4u : 3u, 8 }; }
+	// Converts the entries to the output format(only the 4-channel formats change them), after the entries
+	// are converted the palette always has an alpha channel
+	void ConvertColors(const OutputFormat &format);
+	// Selects the kernels, must be called after the chunks are read and before ExpandRow()
+	void Prepare(const uint32_t &bitDepth, const uint32_t &width);
+	// Converts a reconstructed row of indices(in the layout of the scanlines) to the output format. Indices
+	// outside the palette give opaque black
+	void ExpandRow(const byte_t *row, byte_t *output);
+	// Same as above for a row of "width" indices(e.g. a reduced row of an interlaced image). Can be called from
+	// multiple threads, each with its own "indices" buffer of "width" bytes(only used for sub-byte indices)
+	void ExpandRow(const byte_t *row, byte_t *output, const uint32_t &width, byte_t *indices) const;
+
+private: // Variables
+	uint32_t m_aColors[PALETTE_SIZE]; // RGBA in memory order
+	alignas(16) byte_t m_aPlanes[4 * SHUFFLE_PALETTE_SIZE]; // Red, green, blue and alpha of the first entries
+	uint32_t m_uCount;
+	bool m_bAlpha;
+	uint32_t m_uWidth;
+	binary_t m_vIndices; // The unpacked indices of the current row, only for sub-byte indices
+	ExpandRowFunction m_fnExpand;
+	UnpackRowFunction m_fnUnpack; // nullptr for 8-bit indices
+};
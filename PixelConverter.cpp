@@ -0,0 +1,241 @@
+#include "PixelConverter.h"
+#include "CPUFeatures.h"
+
+#ifdef PNG_X86
+#include <immintrin.h>
+#endif
+
+template <uint32_t BitDepth>
+static inline uint32_t To8Bit(const uint32_t &sample)
+{
+	// Sub-byte samples are scaled, so the largest value becomes 255(e.g. 1-bit samples are multiplied by 255)
+	return (BitDepth == 16) ? sample >> 8 : (BitDepth == 8) ? sample : sample * (UINT8_MAX / ((1u << BitDepth) - 1));
+}
+
+// Returns round(color * alpha / 255) without a division
+static inline uint32_t Premultiply(const uint32_t &color, const uint32_t &alpha)
+{
+	uint32_t product = color * alpha + 128;
+	return (product + (product >> 8)) >> 8;
+}
+
+template <uint32_t Channels, uint32_t BitDepth, OutputFormat Format>
+static void ConvertScalar(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const bool bgr = (Format == OutputFormat::BGRA8 || Format == OutputFormat::BGRA8_PREMULTIPLIED);
+	const bool premultiply = (Format == OutputFormat::RGBA8_PREMULTIPLIED || Format == OutputFormat::BGRA8_PREMULTIPLIED);
+	for (size_t x = 0; x < width; x++) {
+		uint32_t samples[Channels];
+		for (uint32_t c = 0; c < Channels; c++)
+			samples[c] = To8Bit<BitDepth>(ReadSample<BitDepth>(row, x * Channels + c));
+		if (Format == OutputFormat::DEPTH8) {
+			for (uint32_t c = 0; c < Channels; c++)
+				output[x * Channels + c] = (byte_t)samples[c];
+			continue;
+		}
+
+		// Grayscale has the same value in the 3 colors
+		uint32_t r = samples[0];
+		uint32_t g = samples[(Channels >= 3) ? 1 : 0];
+		uint32_t b = samples[(Channels >= 3) ? 2 : 0];
+		uint32_t a = (Channels == 2 || Channels == 4) ? samples[Channels - 1] : UINT8_MAX;
+		if (premultiply) {
+			r = Premultiply(r, a);
+			g = Premultiply(g, a);
+			b = Premultiply(b, a);
+		}
+		byte_t *pixel = output + 4 * x;
+		pixel[0] = (byte_t)(bgr ? b : r);
+		pixel[1] = (byte_t)g;
+		pixel[2] = (byte_t)(bgr ? r : b);
+		pixel[3] = (byte_t)a;
+	}
+}
+
+// Selects the scalar kernel for the input format given as template arguments by DispatchFormat()
+struct ScalarKernelSelector {
+	const OutputFormat &format;
+	ConvertRowFunction &kernel;
+
+	template <uint32_t Channels, uint32_t BitDepth>
+	void Run() {
+		switch (format)
+		{
+		case OutputFormat::DEPTH8: kernel = ConvertScalar<Channels, BitDepth, OutputFormat::DEPTH8>; break;
+		case OutputFormat::RGBA8: kernel = ConvertScalar<Channels, BitDepth, OutputFormat::RGBA8>; break;
+		case OutputFormat::BGRA8: kernel = ConvertScalar<Channels, BitDepth, OutputFormat::BGRA8>; break;
+		case OutputFormat::RGBA8_PREMULTIPLIED: kernel = ConvertScalar<Channels, BitDepth, OutputFormat::RGBA8_PREMULTIPLIED>; break;
+		case OutputFormat::BGRA8_PREMULTIPLIED: kernel = ConvertScalar<Channels, BitDepth, OutputFormat::BGRA8_PREMULTIPLIED>; break;
+		default: kernel = nullptr; break;
+		}
+	}
+};
+
+#ifdef PNG_X86
+// Keeps the first byte(the high one) of each 16-bit sample
+template <uint32_t Channels>
+TARGET_SSE2 static void Narrow16SSE2(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const size_t count = width * Channels;
+	const __m128i highBytes = _mm_set1_epi16(0x00FF); // The first byte in memory is the low byte of a 16-bit lane
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i first = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + 2 * i)), highBytes);
+		__m128i second = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + 2 * i + 16)), highBytes);
+		_mm_storeu_si128((__m128i*)(output + i), _mm_packus_epi16(first, second));
+	}
+	for (; i < count; i++)
+		output[i] = row[2 * i];
+}
+
+TARGET_SSE41 static void SwizzleSSSE3(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+		_mm_storeu_si128((__m128i*)(output + 4 * x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(row + 4 * x)), swap));
+	ConvertScalar<4, 8, OutputFormat::BGRA8>(row + 4 * x, output + 4 * x, width - x);
+}
+
+TARGET_AVX2 static void SwizzleAVX2(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t x = 0;
+	for (; x + 8 <= width; x += 8)
+		_mm256_storeu_si256((__m256i*)(output + 4 * x), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(row + 4 * x)), swap));
+	ConvertScalar<4, 8, OutputFormat::BGRA8>(row + 4 * x, output + 4 * x, width - x);
+}
+
+// RGB8 to RGBA8 or BGRA8 with opaque alpha
+template <bool Bgr>
+TARGET_SSE41 static void AddAlphaSSSE3(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const __m128i spread = Bgr ?
+		_mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+		_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+	// 16 bytes are loaded for the 12 of 4 pixels, so the last pixels of the row are left to the scalar code
+	size_t x = 0;
+	for (; x + 6 <= width; x += 4) {
+		__m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(row + 3 * x)), spread);
+		_mm_storeu_si128((__m128i*)(output + 4 * x), _mm_or_si128(pixels, opaque));
+	}
+	ConvertScalar<3, 8, Bgr ? OutputFormat::BGRA8 : OutputFormat::RGBA8>(row + 3 * x, output + 4 * x, width - x);
+}
+
+// Premultiplies 4 RGBA8 pixels, the alpha bytes are kept
+TARGET_SSE41 static inline __m128i Premultiply4(const __m128i &pixels)
+{
+	const __m128i spreadAlpha = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+	const __m128i alphaBytes = _mm_set1_epi32((int)0xFF000000);
+	const __m128i half = _mm_set1_epi16(128);
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i alpha = _mm_shuffle_epi8(pixels, spreadAlpha);
+	__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(alpha, zero)), half);
+	__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(alpha, zero)), half);
+	low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+	high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+	return _mm_blendv_epi8(_mm_packus_epi16(low, high), pixels, alphaBytes);
+}
+
+template <bool Bgr>
+TARGET_SSE41 static void PremultiplySSE41(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = Premultiply4(_mm_loadu_si128((const __m128i*)(row + 4 * x)));
+		if (Bgr)
+			pixels = _mm_shuffle_epi8(pixels, swap);
+		_mm_storeu_si128((__m128i*)(output + 4 * x), pixels);
+	}
+	ConvertScalar<4, 8, Bgr ? OutputFormat::BGRA8_PREMULTIPLIED : OutputFormat::RGBA8_PREMULTIPLIED>(row + 4 * x, output + 4 * x, width - x);
+}
+
+template <bool Bgr>
+TARGET_AVX2 static void PremultiplyAVX2(const byte_t *row, byte_t *output, const size_t &width)
+{
+	const __m256i spreadAlpha = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+		3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+	const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	const __m256i alphaBytes = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i half = _mm256_set1_epi16(128);
+	const __m256i zero = _mm256_setzero_si256();
+
+	size_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i pixels = _mm256_loadu_si256((const __m256i*)(row + 4 * x));
+		__m256i alpha = _mm256_shuffle_epi8(pixels, spreadAlpha);
+		__m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), _mm256_unpacklo_epi8(alpha, zero)), half);
+		__m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), _mm256_unpackhi_epi8(alpha, zero)), half);
+		low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+		high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+		// The unpack and pack instructions work inside each 128-bit lane, so the pixels stay in their order
+		__m256i result = _mm256_blendv_epi8(_mm256_packus_epi16(low, high), pixels, alphaBytes);
+		if (Bgr)
+			result = _mm256_shuffle_epi8(result, swap);
+		_mm256_storeu_si256((__m256i*)(output + 4 * x), result);
+	}
+	PremultiplySSE41<Bgr>(row + 4 * x, output + 4 * x, width - x);
+}
+#endif
+
+PixelConverter::PixelConverter()
+	: m_stOutput{ 0, 8 }, m_fnConvert(nullptr)
+{
+}
+
+PixelConverter::~PixelConverter()
+{
+}
+
+void PixelConverter::Prepare(const SampleFormat & input, const OutputFormat & format)
+{
+	m_fnConvert = nullptr;
+	m_stOutput = input;
+	if (format == OutputFormat::NATIVE)
+		return;
+	m_stOutput = { IsFourChannel(format) ? 4 : input.channels, 8 };
+	bool rgba8 = (input.channels == 4 && input.bitDepth == 8);
+	if ((format == OutputFormat::DEPTH8 && input.bitDepth == 8) || (format == OutputFormat::RGBA8 && rgba8))
+		return; // Nothing to convert
+
+	DispatchFormat(input, ScalarKernelSelector{ format, m_fnConvert });
+
+#ifdef PNG_X86
+	InstructionSet instructionSet = GetInstructionSet();
+	bool bgr = (format == OutputFormat::BGRA8 || format == OutputFormat::BGRA8_PREMULTIPLIED);
+	bool premultiply = (format == OutputFormat::RGBA8_PREMULTIPLIED || format == OutputFormat::BGRA8_PREMULTIPLIED);
+	if (input.bitDepth == 16 && (format == OutputFormat::DEPTH8 || (format == OutputFormat::RGBA8 && input.channels == 4)) &&
+		instructionSet >= InstructionSet::SSE2) {
+		switch (input.channels)
+		{
+		case 1: m_fnConvert = Narrow16SSE2<1>; break;
+		case 2: m_fnConvert = Narrow16SSE2<2>; break;
+		case 3: m_fnConvert = Narrow16SSE2<3>; break;
+		default: m_fnConvert = Narrow16SSE2<4>; break;
+		}
+	}
+	else if (rgba8 && format == OutputFormat::BGRA8 && instructionSet >= InstructionSet::SSE41) {
+		m_fnConvert = (instructionSet == InstructionSet::AVX2) ? SwizzleAVX2 : SwizzleSSSE3;
+	}
+	else if (input.channels == 3 && input.bitDepth == 8 && !premultiply && instructionSet >= InstructionSet::SSE41) {
+		m_fnConvert = bgr ? AddAlphaSSSE3<true> : AddAlphaSSSE3<false>;
+	}
+	else if (rgba8 && premultiply && instructionSet == InstructionSet::AVX2) {
+		m_fnConvert = bgr ? PremultiplyAVX2<true> : PremultiplyAVX2<false>;
+	}
+	else if (rgba8 && premultiply && instructionSet >= InstructionSet::SSE41) {
+		m_fnConvert = bgr ? PremultiplySSE41<true> : PremultiplySSE41<false>;
+	}
+#endif
+}
+
+bool PixelConverter::IsFourChannel(const OutputFormat & format)
+{
+	return format != OutputFormat::NATIVE && format != OutputFormat::DEPTH8;
+}
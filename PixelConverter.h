@@ -0,0 +1,41 @@
+#pragma once
+#include <Binary.h>
+#include "Image.h"
+
+// Pixel format of the decoded image
+enum class OutputFormat {
+	NATIVE, // The samples as they are stored in the file(indexed images are expanded to RGB8 or RGBA8)
+	DEPTH8, // Same channels with 8-bit samples. 16-bit samples keep their high byte and sub-byte ones are scaled
+	RGBA8, // Grayscale is copied to the 3 colors and a missing alpha is opaque
+	BGRA8,
+	RGBA8_PREMULTIPLIED, // The colors are multiplied by alpha
+	BGRA8_PREMULTIPLIED
+};
+
+// Converts a row of "width" pixels
+typedef void(*ConvertRowFunction)(const byte_t *row, byte_t *output, const size_t &width);
+
+
+// Converts reconstructed rows to the requested output format. There is a kernel compiled for each input and
+// output format, selected once per image. The common cases have SIMD kernels: RGBA8 to BGRA8, RGB8 to
+// RGBA8/BGRA8, premultiplying RGBA8 and narrowing 16-bit samples. The output row may be the input row only
+// if the pixels don't get wider.
+class PixelConverter
+{
+public:
+	PixelConverter();
+	~PixelConverter();
+
+	void Prepare(const SampleFormat &input, const OutputFormat &format);
+	SampleFormat GetOutputFormat() const { return m_stOutput; }
+	// True if the output is the same as the input, in which case ConvertRow() should not be called
+	bool IsIdentity() const { return m_fnConvert == nullptr; }
+	void ConvertRow(const byte_t *row, byte_t *output, const size_t &width) const { m_fnConvert(row, output, width); }
+
+	// True for the formats with 4 channels of 8 bits(RGBA8, BGRA8 and the premultiplied ones)
+	static bool IsFourChannel(const OutputFormat &format);
+
+private: // Variables
+	SampleFormat m_stOutput;
+	ConvertRowFunction m_fnConvert;
+};
@@ -1,7 +1,9 @@
 #include "RingBuffer.h"
+#include <algorithm> // used for std::min()
+#include <cstring> // used for memcpy()
 
 RingBuffer::RingBuffer(const size_t & size)
-	: m_vData(size), m_uPosition(0)
+	: m_vData(size), m_uPosition(0), m_uPending(0), m_uWritten(0)
 {}
 
 RingBuffer::~RingBuffer()
@@ -12,19 +14,64 @@ void RingBuffer::AppendByte(const byte_t &byte)
 {
 	m_vData.at(m_uPosition) = byte;
 	AdvanceCursor(m_uPosition);
+	m_uPending++;
+	m_uWritten++;
 }
 
-void RingBuffer::WriteToObject(const uint32_t & distance, const uint32_t & length, Binary & bObj)
+void RingBuffer::AppendData(const byte_t * data, const size_t & size)
 {
+	Write(data, size);
+	m_uPending += size;
+}
+
+void RingBuffer::AppendHistory(const byte_t * data, const size_t & size)
+{
+	Write(data, size);
+}
+
+void RingBuffer::CopyMatch(const uint32_t & distance, const uint32_t & length)
+{
+	if (distance > std::min(m_uWritten, m_vData.size()))
+		throw "Distance points before the beginning of the stream!";
 	size_t readIndex = (m_vData.size() + m_uPosition - distance) % m_vData.size();
 	for (size_t i = 0; i < length; i++)
 	{
-		byte_t byte = ReadByte(&readIndex);
-		AppendByte(byte);
-		bObj.AppendData(byte);
+		AppendByte(ReadByte(&readIndex));
 	}
 }
 
+void RingBuffer::Flush(const ByteSink & sink)
+{
+	if (m_uPending > m_vData.size())
+		throw "Pending data in the ring buffer was overwritten before being flushed!";
+
+	// The pending bytes are split in two parts when they wrap around the end of the buffer
+	size_t start = (m_vData.size() + m_uPosition - m_uPending) % m_vData.size();
+	if (m_uPending > 0 && start + m_uPending > m_vData.size()) {
+		sink(m_vData.data() + start, m_vData.size() - start);
+		sink(m_vData.data(), m_uPosition);
+	}
+	else if (m_uPending > 0) {
+		sink(m_vData.data() + start, m_uPending);
+	}
+	m_uPending = 0;
+}
+
+void RingBuffer::Write(const byte_t * data, size_t size)
+{
+	m_uWritten += size;
+	if (size > m_vData.size()) {
+		data += size - m_vData.size();
+		size = m_vData.size();
+	}
+
+	// Copying in two parts when the data wraps around the end of the buffer
+	size_t first = std::min(size, m_vData.size() - m_uPosition);
+	memcpy(m_vData.data() + m_uPosition, data, first);
+	memcpy(m_vData.data(), data + first, size - first);
+	m_uPosition = (m_uPosition + size) % m_vData.size();
+}
+
 byte_t RingBuffer::ReadByte(size_t *index)
 {
 	if (index == nullptr)
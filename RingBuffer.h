@@ -1,21 +1,40 @@
 #pragma once
 #include <vector>
+#include <functional>
 #include <Binary.h>
 
+// Receives the next part of a decompressed stream
+typedef std::function<void(const byte_t *data, const size_t &size)> ByteSink;
+
 class RingBuffer
 {
 public:
 	RingBuffer(const size_t &size);
 	~RingBuffer();
 	void AppendByte(const byte_t &byte);
-	void WriteToObject(const uint32_t &distance, const uint32_t &length, Binary &bObj);
+	void AppendData(const byte_t *data, const size_t &size);
+	// Same as AppendData(), but the bytes are not pending(the caller has already passed them on). Only the last
+	// bytes that fit in the buffer are kept
+	void AppendHistory(const byte_t *data, const size_t &size);
+	// Appends "length" bytes starting "distance" bytes back. Throws if the distance points before the first byte
+	// of the stream or further back than the buffer keeps
+	void CopyMatch(const uint32_t &distance, const uint32_t &length);
+	// Number of bytes written since the last Flush()
+	size_t Pending() const { return m_uPending; }
+	// Passes the pending bytes to the sink. Must be called before they get overwritten(Pending() reaches the buffer size)
+	void Flush(const ByteSink &sink);
+	// Empties the buffer for a new stream
+	void Reset() { m_uPosition = 0; m_uPending = 0; m_uWritten = 0; }
 
 private: // Methods
+	void Write(const byte_t *data, size_t size);
 	byte_t ReadByte(size_t *index = nullptr);
 	inline void AdvanceCursor(size_t &cursor);
 
 private: // Variables
 	binary_t m_vData;
 	size_t m_uPosition;
+	size_t m_uPending;
+	size_t m_uWritten; // Bytes written since the last Reset()
 };
 
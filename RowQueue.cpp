@@ -0,0 +1,84 @@
+#include "RowQueue.h"
+#include <thread>
+#include <algorithm> // used for std::min()
+#include <cstring> // used for memcpy()
+
+RowQueue::RowQueue()
+	: m_uRowSize(1), m_uSlots(0), m_uHeight(0), m_uWritten(0), m_uFilled(0), m_uHead(0), m_uTail(0), m_bClosed(false), m_bAborted(false)
+{}
+
+RowQueue::RowQueue(const uint32_t & height, const size_t & rowBytes, const size_t & slots)
+	: RowQueue()
+{
+	Reset(height, rowBytes, slots);
+}
+
+RowQueue::~RowQueue()
+{
+}
+
+void RowQueue::Reset(const uint32_t & height, const size_t & rowBytes, const size_t & slots)
+{
+	m_vData.resize(slots * (rowBytes + 1));
+	m_uRowSize = rowBytes + 1;
+	m_uSlots = slots;
+	m_uHeight = height;
+	m_uWritten = 0;
+	m_uFilled = 0;
+	m_uHead.store(0, std::memory_order_relaxed);
+	m_uTail.store(0, std::memory_order_relaxed);
+	m_bClosed.store(false, std::memory_order_relaxed);
+	m_bAborted.store(false, std::memory_order_relaxed);
+}
+
+void RowQueue::Write(const byte_t * data, size_t size)
+{
+	while (size > 0 && !Finished()) {
+		if (m_uFilled == 0) {
+			// Waiting for the consumer to free a slot
+			while (m_uWritten - m_uHead.load(std::memory_order_acquire) == m_uSlots) {
+				if (Aborted())
+					throw "The row consumer has stopped!";
+				std::this_thread::yield();
+			}
+		}
+
+		size_t count = std::min(size, m_uRowSize - m_uFilled);
+		memcpy(Slot(m_uWritten) + m_uFilled, data, count);
+		data += count;
+		size -= count;
+		m_uFilled += count;
+
+		if (m_uFilled == m_uRowSize) {
+			m_uFilled = 0;
+			m_uTail.store(++m_uWritten, std::memory_order_release);
+		}
+	}
+}
+
+void RowQueue::Close()
+{
+	m_bClosed.store(true, std::memory_order_release);
+}
+
+const byte_t * RowQueue::Front()
+{
+	size_t head = m_uHead.load(std::memory_order_relaxed);
+	while (head == m_uTail.load(std::memory_order_acquire)) {
+		// The tail is checked again after seeing the flag, because the last rows may have been published right before it
+		if (Aborted() || (m_bClosed.load(std::memory_order_acquire) && head == m_uTail.load(std::memory_order_acquire)))
+			return nullptr;
+		std::this_thread::yield();
+	}
+	return Slot(head);
+}
+
+void RowQueue::Pop()
+{
+	m_uHead.store(m_uHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void RowQueue::Abort()
+{
+	m_bAborted.store(true, std::memory_order_release);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <Binary.h>
+
+#define ROW_QUEUE_SLOTS 64 // Default number of rows that can wait between the two threads
+
+
+// Lock-free single-producer/single-consumer queue of filtered scanlines(the filter byte followed by the row).
+// The producer writes the decompressed stream, which is split into rows directly in the slots of the queue.
+// The consumer takes the rows in order. Each side waits(yielding the thread) while the queue is full or empty.
+class RowQueue
+{
+public:
+	RowQueue();
+	RowQueue(const uint32_t &height, const size_t &rowBytes, const size_t &slots = ROW_QUEUE_SLOTS);
+	~RowQueue();
+
+	// Empties the queue for an image with the given size. The buffer of the slots is reused when it is big enough.
+	// Neither side may use the queue while it is reset
+	void Reset(const uint32_t &height, const size_t &rowBytes, const size_t &slots = ROW_QUEUE_SLOTS);
+
+	// Producer side
+	// Feeds the next part of the decompressed stream. Data after the last row is ignored.
+	// Throws if the consumer has stopped(see Abort())
+	void Write(const byte_t *data, size_t size);
+	// No more rows will be written
+	void Close();
+	bool Finished() const { return m_uWritten == m_uHeight; }
+
+	// Consumer side
+	// Waits for the next row, returns nullptr if the producer closed the queue and all rows are taken
+	const byte_t *Front();
+	// Frees the slot of the row returned by Front()
+	void Pop();
+
+	// Stops both sides, e.g. when one of them fails
+	void Abort();
+	bool Aborted() const { return m_bAborted.load(std::memory_order_acquire); }
+
+private: // Methods
+	byte_t *Slot(const size_t &index) { return m_vData.data() + (index % m_uSlots) * m_uRowSize; }
+
+private: // Variables
+	binary_t m_vData;
+	size_t m_uRowSize; // Including the filter byte
+	size_t m_uSlots;
+	uint32_t m_uHeight;
+	uint32_t m_uWritten; // Rows completed by the producer
+	size_t m_uFilled; // Bytes of the row being written
+	std::atomic<size_t> m_uHead; // Next row for the consumer
+	std::atomic<size_t> m_uTail; // Rows published by the producer
+	std::atomic<bool> m_bClosed;
+	std::atomic<bool> m_bAborted;
+};
@@ -0,0 +1,41 @@
+#include "ScanlineReader.h"
+#include <algorithm> // used for std::min() and std::swap()
+#include <cstring> // used for memcpy()
+
+ScanlineReader::ScanlineReader(const uint32_t & width, const uint32_t & height, const SampleFormat & format, const RowCallback & callback)
+	: m_oUnfilter(format.PixelSize()), m_fnCallback(callback), m_uHeight(height), m_uRowBytes(format.RowBytes(width)),
+	m_vRows(2 * (m_uRowBytes + UNFILTER_PADDING)), m_uFilter(0), m_uFilled(0), m_uRow(0)
+{
+	// The previous row starts as a row of zeros
+	m_pPrevious = m_vRows.data();
+	m_pCurrent = m_vRows.data() + m_uRowBytes + UNFILTER_PADDING;
+}
+
+ScanlineReader::~ScanlineReader()
+{
+}
+
+void ScanlineReader::Write(const byte_t * data, size_t size)
+{
+	while (size > 0 && !Finished()) {
+		if (m_uFilled == 0) {
+			m_uFilter = *data++;
+			size--;
+			m_uFilled++;
+			continue;
+		}
+
+		size_t count = std::min(size, m_uRowBytes + 1 - m_uFilled);
+		memcpy(m_pCurrent + m_uFilled - 1, data, count);
+		data += count;
+		size -= count;
+		m_uFilled += count;
+
+		if (m_uFilled == m_uRowBytes + 1) {
+			m_oUnfilter.UnfilterRow(m_uFilter, m_pCurrent, m_pPrevious, m_uRowBytes);
+			m_fnCallback(m_uRow++, m_pCurrent, m_uRowBytes);
+			std::swap(m_pPrevious, m_pCurrent);
+			m_uFilled = 0;
+		}
+	}
+}
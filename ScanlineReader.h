@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include <Binary.h>
+#include "PNGUnfilter.h"
+#include "Image.h"
+
+// Receives a reconstructed row(in the layout described by SampleFormat), the data is valid only during the call
+typedef std::function<void(const uint32_t &y, const byte_t *row, const size_t &rowBytes)> RowCallback;
+
+
+// Splits a decompressed stream into scanlines as it arrives and reverses their filters.
+// Only the current and the previous row are kept in memory.
+class ScanlineReader
+{
+public:
+	ScanlineReader(const uint32_t &width, const uint32_t &height, const SampleFormat &format, const RowCallback &callback);
+	~ScanlineReader();
+
+	// Feeds the next part of the decompressed stream. Data after the last row is ignored
+	void Write(const byte_t *data, size_t size);
+	bool Finished() const { return m_uRow == m_uHeight; }
+
+private: // Variables
+	PNGUnfilter m_oUnfilter;
+	RowCallback m_fnCallback;
+	uint32_t m_uHeight;
+	size_t m_uRowBytes;
+	binary_t m_vRows; // The previous and the current row, each followed by UNFILTER_PADDING bytes
+	byte_t *m_pPrevious;
+	byte_t *m_pCurrent;
+	byte_t m_uFilter;
+	size_t m_uFilled; // Bytes of the current row read so far, including the filter byte
+	uint32_t m_uRow;
+};
@@ -0,0 +1,84 @@
+// Counts the allocations with a replaced operator new. A Decoder that has decoded a set of images must
+// decode the same set again without allocating, from memory and from files, plain and pipelined. The
+// large interlaced image is reconstructed on a thread pool
+#include <iostream>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "Decoder.h"
+#include "TestUtils.h"
+
+#define POOL_THREADS 4
+
+static std::atomic<size_t> g_allocations(0);
+
+void *operator new(size_t size)
+{
+	g_allocations++;
+	void *memory = malloc(size != 0 ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	free(memory);
+}
+
+// Returns the number of allocations made while decoding all the images
+static size_t DecodeAll(Decoder &decoder, const std::vector<binary_t> &inputs, const std::vector<std::string> &files, Image &image)
+{
+	size_t before = g_allocations;
+	for (const binary_t &input : inputs)
+		CHECK(decoder.Decode(input.data(), input.size(), image));
+	for (const std::string &file : files)
+		CHECK(decoder.DecodeFile(file, image));
+	return g_allocations - before;
+}
+
+int main()
+{
+	// The largest image is not the first one, so the buffers grow during the first round
+	std::vector<binary_t> inputs;
+	inputs.push_back(MakeTestPNG(120, 80, 2, 8, false, 1));
+	inputs.push_back(MakeTestPNG(640, 480, 6, 8, false, 2));
+	inputs.push_back(MakeTestPNG(333, 250, 3, 4, false, 3));
+	inputs.push_back(MakeTestPNG(200, 121, 4, 16, true, 4));
+	inputs.push_back(MakeTestPNG(97, 1, 0, 1, true, 5));
+	inputs.push_back(MakeTestPNG(600, 401, 6, 8, true, 6));
+
+	std::vector<std::string> files;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		files.push_back("allocation_test_" + std::to_string(i) + ".png");
+		CHECK(WriteTestFile(files.back(), inputs[i]));
+	}
+
+	const OutputFormat formats[] = { OutputFormat::NATIVE, OutputFormat::RGBA8 };
+	ThreadPool pool(POOL_THREADS);
+	for (const OutputFormat &format : formats) {
+		for (int pipelined = 0; pipelined < 2; pipelined++) {
+			Decoder decoder;
+			Image image;
+			decoder.SetOutputFormat(format);
+			decoder.SetPipelined(pipelined != 0);
+			decoder.SetThreadPool(&pool);
+			// The first round allocates the buffers, which also shows that the counter works
+			CHECK(DecodeAll(decoder, inputs, files, image) > 0);
+			size_t allocations = DecodeAll(decoder, inputs, files, image);
+			std::cout << "Output format " << (int)format << (pipelined ? ", pipelined" : "") << ": " << allocations
+				<< " allocations in the second round\n";
+			CHECK(allocations == 0);
+		}
+	}
+
+	for (const std::string &file : files)
+		std::remove(file.c_str());
+	return TestResult();
+}
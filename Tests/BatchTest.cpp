@@ -0,0 +1,80 @@
+// Decodes a batch of generated files on several threads and compares every result with the same file
+// decoded by a single Decoder. Build with SANITIZE=thread to check the pool and the worker contexts for races
+#include <iostream>
+#include <cstdio>
+#include "BatchDecoder.h"
+#include "TestUtils.h"
+
+#define BATCH_THREADS 4
+#define BATCH_ROUNDS 3 // The same BatchDecoder is used again, so the workers reuse their contexts
+
+struct TestFormat {
+	uint8_t colorType;
+	uint8_t bitDepth;
+};
+
+int main()
+{
+	static const TestFormat formats[] = {
+		{ 0, 1 }, { 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 16 }, { 2, 8 }, { 2, 16 },
+		{ 3, 1 }, { 3, 2 }, { 3, 4 }, { 3, 8 }, { 4, 8 }, { 4, 16 }, { 6, 8 }, { 6, 16 }
+	};
+
+	std::vector<std::string> files;
+	uint32_t seed = 1;
+	for (const TestFormat &format : formats) {
+		for (int interlaced = 0; interlaced < 2; interlaced++, seed++) {
+			// Sizes from a single pixel up to a few hundred thousand pixels, so the tasks take different times
+			uint32_t width = 1 + seed * 37 % 700, height = 1 + seed * 53 % 400;
+			std::string path = "batch_test_" + std::to_string(files.size()) + ".png";
+			CHECK(WriteTestFile(path, MakeTestPNG(width, height, format.colorType, format.bitDepth, interlaced != 0, seed)));
+			files.push_back(path);
+		}
+	}
+	// A corrupted file(the image data is cut short) and a missing one fail without stopping the batch
+	binary_t truncated = MakeTestPNG(300, 200, 6, 8, false, seed);
+	truncated.resize(truncated.size() / 2);
+	CHECK(WriteTestFile("batch_test_truncated.png", truncated));
+	files.push_back("batch_test_truncated.png");
+	files.push_back("batch_test_missing.png");
+
+	// The expected results
+	std::vector<Image> expected(files.size());
+	std::vector<bool> decoded(files.size());
+	Decoder decoder;
+	for (size_t i = 0; i < files.size(); i++) {
+		try {
+			decoded[i] = decoder.DecodeFile(files[i], expected[i]);
+		}
+		catch (const char *) {
+			decoded[i] = false;
+		}
+	}
+	CHECK(!decoded[files.size() - 2]);
+	CHECK(!decoded[files.size() - 1]);
+
+	BatchDecoder batch(BATCH_THREADS);
+	for (int round = 0; round < BATCH_ROUNDS; round++) {
+		// Written by the workers, one element for each file
+		std::vector<char> matches(files.size(), 0);
+		std::vector<BatchResult> results = batch.Decode(files, [&](const size_t &index, const BatchResult &, const Image &image) {
+			matches[index] = SameImage(expected[index], image) ? 1 : 0;
+		});
+
+		CHECK(results.size() == files.size());
+		for (size_t i = 0; i < results.size(); i++) {
+			CHECK(results[i].path == files[i]);
+			CHECK(results[i].error.empty() == decoded[i]);
+			if (!decoded[i])
+				continue;
+			CHECK(matches[i] == 1);
+			CHECK(results[i].width == expected[i].Width());
+			CHECK(results[i].height == expected[i].Height());
+			CHECK(results[i].dataSize > 0);
+		}
+	}
+
+	for (const std::string &path : files)
+		std::remove(path.c_str());
+	return TestResult();
+}
@@ -0,0 +1,66 @@
+// Compares the checksum kernels selected for this CPU with the scalar code, for every length up to a few
+// blocks, at unaligned offsets, with the calculation split in two calls and for inputs long enough for many reductions
+#include <iostream>
+#include <random>
+#include "CRC32.h"
+#include "Adler32.h"
+#include "TestUtils.h"
+
+#define MAX_TEST_LENGTH 2000
+#define MAX_TEST_OFFSET 16 // Offsets from the aligned beginning of the buffer
+#define LARGE_TEST_LENGTH 200000 // More than 32 times the bytes the Adler-32 kernels add between two reductions
+
+int main()
+{
+	// The check value of the CRC-32 used by PNG
+	static const byte_t digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	CHECK(UpdateCRC32(0, digits, sizeof(digits)) == 0xCBF43926);
+	CHECK(UpdateCRC32Scalar(0, digits, sizeof(digits)) == 0xCBF43926);
+	CHECK(UpdateCRC32(0, nullptr, 0) == 0);
+	static const byte_t text[] = { 'W', 'i', 'k', 'i', 'p', 'e', 'd', 'i', 'a' };
+	CHECK(UpdateAdler32(1, text, sizeof(text)) == 0x11E60398);
+	CHECK(UpdateAdler32Scalar(1, text, sizeof(text)) == 0x11E60398);
+	CHECK(UpdateAdler32(1, nullptr, 0) == 1);
+
+	std::mt19937 random(1);
+	binary_t data(MAX_TEST_OFFSET + MAX_TEST_LENGTH);
+	for (byte_t &value : data)
+		value = (byte_t)random();
+	for (size_t offset = 0; offset < MAX_TEST_OFFSET; offset++) {
+		for (size_t length = 0; length <= MAX_TEST_LENGTH; length++) {
+			const byte_t *begin = data.data() + offset;
+			uint32_t expected = UpdateCRC32Scalar(0, begin, length);
+			CHECK(UpdateCRC32(0, begin, length) == expected);
+			// Continuing from a running value that isn't 0
+			size_t split = random() % (length + 1);
+			CHECK(UpdateCRC32(UpdateCRC32(0, begin, split), begin + split, length - split) == expected);
+
+			expected = UpdateAdler32Scalar(1, begin, length);
+			CHECK(UpdateAdler32(1, begin, length) == expected);
+			CHECK(UpdateAdler32(UpdateAdler32(1, begin, split), begin + split, length - split) == expected);
+		}
+	}
+
+	// All bytes 0xFF make the sums grow the fastest, so a reduction that comes too late overflows them
+	binary_t large(MAX_TEST_OFFSET + LARGE_TEST_LENGTH, 0xFF);
+	CHECK(UpdateAdler32Scalar(1, large.data(), LARGE_TEST_LENGTH) == 0x14D06057); // The value from zlib
+	for (size_t offset = 0; offset < MAX_TEST_OFFSET; offset += 5) {
+		const byte_t *begin = large.data() + offset;
+		uint32_t expected = UpdateAdler32Scalar(1, begin, LARGE_TEST_LENGTH);
+		CHECK(UpdateAdler32(1, begin, LARGE_TEST_LENGTH) == expected);
+		// From the largest running sums
+		CHECK(UpdateAdler32(0xFFF0FFF0, begin, LARGE_TEST_LENGTH) == UpdateAdler32Scalar(0xFFF0FFF0, begin, LARGE_TEST_LENGTH));
+	}
+	for (byte_t &value : large)
+		value = (byte_t)random();
+	for (int i = 0; i < 20; i++) {
+		size_t offset = random() % MAX_TEST_OFFSET;
+		size_t length = random() % (LARGE_TEST_LENGTH + 1);
+		size_t split = random() % (length + 1);
+		const byte_t *begin = large.data() + offset;
+		uint32_t expected = UpdateAdler32Scalar(1, begin, length);
+		CHECK(UpdateAdler32(1, begin, length) == expected);
+		CHECK(UpdateAdler32(UpdateAdler32(1, begin, split), begin + split, length - split) == expected);
+	}
+	return TestResult();
+}
@@ -0,0 +1,103 @@
+// Checks that invalid image sizes and images above the size limit are rejected from the IHDR chunk, before
+// the buffers for the image are allocated, and that Probe() accepts only the exact PNG signature
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include "Decoder.h"
+#include "TestUtils.h"
+
+#define HEADER_ALLOCATION_LIMIT (1 << 20) // More than the chunks and the inflator need, far less than the images
+
+static std::atomic<size_t> g_allocatedBytes(0);
+
+void *operator new(size_t size)
+{
+	g_allocatedBytes += size;
+	void *memory = malloc(size != 0 ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	free(memory);
+}
+
+// Decodes the image, which must fail with "error" without allocating the image buffers
+static void CheckRejected(Decoder &decoder, const binary_t &png, const char *error)
+{
+	Image image;
+	size_t before = g_allocatedBytes;
+	bool decoded = true;
+	try {
+		decoded = decoder.Decode(png.data(), png.size(), image);
+	}
+	catch (...) {
+		CHECK(!"Decode() threw instead of returning false");
+	}
+	CHECK(!decoded);
+	CHECK(decoder.GetError() != nullptr && strcmp(decoder.GetError(), error) == 0);
+	CHECK(g_allocatedBytes - before < HEADER_ALLOCATION_LIMIT);
+}
+
+int main()
+{
+	Decoder decoder, pipelined;
+	pipelined.SetPipelined(true);
+	Decoder *decoders[] = { &decoder, &pipelined };
+	for (Decoder *tested : decoders) {
+		// The specification allows 1 to 2^31 - 1 pixels in both directions
+		CheckRejected(*tested, MakeTestHeaderPNG(0, 10, 6, 8), "Invalid image size!");
+		CheckRejected(*tested, MakeTestHeaderPNG(10, 0, 6, 8), "Invalid image size!");
+		CheckRejected(*tested, MakeTestHeaderPNG(0x80000000u, 1, 0, 1), "Invalid image size!");
+		CheckRejected(*tested, MakeTestHeaderPNG(1, 0xFFFFFFFFu, 0, 1), "Invalid image size!");
+
+		// 576 MB of RGBA8 pixels with the default limit
+		CheckRejected(*tested, MakeTestHeaderPNG(12000, 12000, 6, 8), "The image is larger than the size limit!");
+		// 2^32 bytes of image data, which wrap around to 16 bytes with a 32-bit size_t
+		CheckRejected(*tested, MakeTestHeaderPNG(1 << 26, 16, 6, 8), "The image is larger than the size limit!");
+		CheckRejected(*tested, MakeTestHeaderPNG(0x7FFFFFFF, 0x7FFFFFFF, 6, 16), "The image is larger than the size limit!");
+	}
+
+	PNGInfo info;
+	binary_t empty = MakeTestHeaderPNG(0, 0, 2, 8);
+	CHECK(!decoder.Probe(empty.data(), empty.size(), info));
+
+	// Every byte of the signature is compared, each of these differs from it in a single byte
+	binary_t valid = MakeTestHeaderPNG(16, 16, 2, 8);
+	CHECK(decoder.Probe(valid.data(), valid.size(), info));
+	for (size_t i = 0; i < PNG_SIGNATURE_SIZE; i++) {
+		binary_t wrong = valid;
+		wrong[i] ^= 0x01;
+		CHECK(!decoder.Probe(wrong.data(), wrong.size(), info));
+		CHECK(decoder.GetError() != nullptr && strcmp(decoder.GetError(), "File signature mismatch!") == 0);
+	}
+	// Other formats, followed by the rest of a valid PNG, and a datastream shorter than the signature
+	static const byte_t gif[] = { 'G', 'I', 'F', '8', '9', 'a', 0x10, 0x00 };
+	static const byte_t jpeg[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F' };
+	const byte_t *headers[] = { gif, jpeg };
+	for (const byte_t *header : headers) {
+		binary_t other = valid;
+		memcpy(other.data(), header, PNG_SIGNATURE_SIZE);
+		CHECK(!decoder.Probe(other.data(), other.size(), info));
+	}
+	CHECK(!decoder.Probe(valid.data(), PNG_SIGNATURE_SIZE - 1, info));
+
+	// A lower limit, 40000 bytes of pixels don't fit in 10000
+	binary_t png = MakeTestPNG(100, 100, 6, 8, false, 1);
+	decoder.SetSizeLimit(10000);
+	CheckRejected(decoder, png, "The image is larger than the size limit!");
+	decoder.SetSizeLimit(DEFAULT_SIZE_LIMIT);
+	Image image;
+	CHECK(decoder.Decode(png.data(), png.size(), image));
+	CHECK(image.Width() == 100 && image.Height() == 100);
+	return TestResult();
+}
@@ -0,0 +1,37 @@
+// Checks the layout of Image and that the sizes of huge images are rejected instead of wrapping around
+#include <iostream>
+#include <cstring>
+#include "Image.h"
+#include "TestUtils.h"
+
+// Returns true if Resize() throws
+static bool ResizeThrows(Image &image, const uint32_t &width, const uint32_t &height, const SampleFormat &format)
+{
+	try {
+		image.Resize(width, height, format);
+	}
+	catch (const char *) {
+		return true;
+	}
+	return false;
+}
+
+int main()
+{
+	Image image(37, 5, SampleFormat{ 3, 16 });
+	CHECK(image.RowBytes() == 37 * 6);
+	CHECK(image.Stride() % IMAGE_ALIGNMENT == 0);
+	for (uint32_t y = 0; y < image.Height(); y++)
+		CHECK((size_t)image.Row(y) % IMAGE_ALIGNMENT == 0);
+	binary_t zeros(image.RowBytes(), 0);
+	CHECK(memcmp(image.PreviousRow(0), zeros.data(), zeros.size()) == 0);
+
+	// 2^35 bytes per row times 2^32 rows wraps around even with a 64-bit size_t
+	CHECK(ResizeThrows(image, UINT32_MAX, UINT32_MAX, SampleFormat{ 4, 16 }));
+	CHECK(ResizeThrows(image, (uint32_t)1 << 31, UINT32_MAX, SampleFormat{ 4, 16 }));
+	// The image is kept as it was
+	CHECK(image.Width() == 37 && image.Height() == 5 && image.RowBytes() == 37 * 6);
+	CHECK(!ResizeThrows(image, 1, 1, SampleFormat{ 1, 1 }));
+	CHECK(!ResizeThrows(image, 0, 0, SampleFormat{ 4, 8 }));
+	return TestResult();
+}
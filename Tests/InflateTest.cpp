@@ -0,0 +1,526 @@
+// Decodes images from hand-made zlib streams and checks that the valid ones give the expected rows and that
+// the broken ones are rejected with the expected error. The images are gray 8-bit and every row has filter 0,
+// so the decoded rows must be the raw scanlines without the filter bytes. The deflate streams come from zlib
+// or from the small encoder below, which chooses the blocks, the matches and the code lengths
+#include <iostream>
+#include <cstring>
+#include <random>
+#include <queue>
+#include <algorithm>
+#include "Decoder.h"
+#include "TestUtils.h"
+#include "Adler32.h"
+#include "HuffmanTable.h"
+
+#define MAX_MATCH_LENGTH 258
+#define MAX_MATCH_DISTANCE 32768
+#define LENGTH_SYMBOLS 286 // Literals, end of block and the lengths
+#define DISTANCE_SYMBOLS 30
+#define CODE_LENGTH_SYMBOLS 19
+#define END_OF_BLOCK 256
+
+#define MATCH_TEST_WIDTH 255 // The rows are 256 bytes with the filter byte, so 128 rows are exactly 32K
+#define MATCH_TEST_ROWS 128
+
+static const uint8_t g_aCodeLengthOrder[CODE_LENGTH_SYMBOLS] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Literal byte or a match
+struct Token {
+	uint32_t length; // 0 for a literal
+	uint32_t value; // The literal byte or the distance of the match
+};
+
+enum class BlockType {
+	FIXED,
+	DYNAMIC
+};
+
+// Writes a deflate stream, which is filled from the least significant bit of each byte
+class BitWriter
+{
+public:
+	BitWriter() : m_uBits(0), m_uCount(0) {}
+
+	void Write(const uint32_t &value, const uint32_t &bits) {
+		m_uBits |= (uint64_t)value << m_uCount;
+		m_uCount += bits;
+		while (m_uCount >= 8) {
+			m_vData.push_back((byte_t)m_uBits);
+			m_uBits >>= 8;
+			m_uCount -= 8;
+		}
+	}
+	// Huffman codes are written starting from their most significant bit
+	void WriteCode(const uint32_t &code, const uint32_t &length) {
+		for (uint32_t bit = length; bit > 0; bit--)
+			Write((code >> (bit - 1)) & 1, 1);
+	}
+	const binary_t &Finish() {
+		if (m_uCount > 0)
+			Write(0, 8 - m_uCount);
+		return m_vData;
+	}
+
+private:
+	binary_t m_vData;
+	uint64_t m_uBits;
+	uint32_t m_uCount;
+};
+
+// Base values and extra bits of the length(257 - 285) and distance(0 - 29) symbols, from RFC 1951
+static uint32_t LengthExtra(const uint32_t &symbol) { return (symbol < 265 || symbol == 285) ? 0 : (symbol - 261) / 4; }
+static uint32_t DistanceExtra(const uint32_t &symbol) { return symbol < 4 ? 0 : symbol / 2 - 1; }
+
+static uint32_t LengthSymbol(const uint32_t &length, uint32_t &extra)
+{
+	if (length == MAX_MATCH_LENGTH) {
+		extra = 0;
+		return 285;
+	}
+	for (uint32_t symbol = 257, base = 3; symbol < 285; base += 1u << LengthExtra(symbol), symbol++) {
+		if (length < base + (1u << LengthExtra(symbol))) {
+			extra = length - base;
+			return symbol;
+		}
+	}
+	throw "Invalid match length";
+}
+
+static uint32_t DistanceSymbol(const uint32_t &distance, uint32_t &extra)
+{
+	for (uint32_t symbol = 0, base = 1; symbol < DISTANCE_SYMBOLS; base += 1u << DistanceExtra(symbol), symbol++) {
+		if (distance < base + (1u << DistanceExtra(symbol))) {
+			extra = distance - base;
+			return symbol;
+		}
+	}
+	throw "Invalid match distance";
+}
+
+// Greedy matching that only tries the given distances, so the test decides which ones the stream uses
+static std::vector<Token> Tokenize(const binary_t &data, const std::vector<uint32_t> &distances)
+{
+	std::vector<Token> tokens;
+	for (size_t i = 0; i < data.size();) {
+		Token token = { 0, data[i] };
+		for (const uint32_t &distance : distances) {
+			if (distance > i)
+				continue;
+			uint32_t length = 0;
+			while (length < MAX_MATCH_LENGTH && i + length < data.size() && data[i + length] == data[i + length - distance])
+				length++;
+			if (length >= 3 && length > token.length)
+				token = { length, distance };
+		}
+		tokens.push_back(token);
+		i += std::max<size_t>(token.length, 1);
+	}
+	return tokens;
+}
+
+// Huffman code lengths of at most "maxBits" bits for the frequencies. The frequencies are halved until the tree
+// is shallow enough. Every used symbol gets a code, unused ones are added until there are at least two
+static std::vector<uint8_t> MakeCodeLengths(std::vector<uint32_t> frequencies, const uint32_t &maxBits)
+{
+	for (size_t symbol = 0; (size_t)std::count(frequencies.begin(), frequencies.end(), 0u) + 2 > frequencies.size(); symbol++) {
+		if (frequencies[symbol] == 0)
+			frequencies[symbol] = 1;
+	}
+	while (true) {
+		typedef std::pair<uint64_t, size_t> Node; // Weight and index
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+		std::vector<size_t> parents(frequencies.size(), 0);
+		for (size_t symbol = 0; symbol < frequencies.size(); symbol++) {
+			if (frequencies[symbol] != 0)
+				queue.push(Node(frequencies[symbol], symbol));
+		}
+		while (queue.size() > 1) {
+			Node first = queue.top();
+			queue.pop();
+			Node second = queue.top();
+			queue.pop();
+			parents.push_back(0);
+			parents[first.second] = parents[second.second] = parents.size() - 1;
+			queue.push(Node(first.first + second.first, parents.size() - 1));
+		}
+		std::vector<uint8_t> lengths(frequencies.size(), 0);
+		bool fits = true;
+		for (size_t symbol = 0; symbol < frequencies.size(); symbol++) {
+			if (frequencies[symbol] == 0)
+				continue;
+			for (size_t node = symbol; node != parents.size() - 1; node = parents[node])
+				lengths[symbol]++;
+			fits = fits && lengths[symbol] <= maxBits;
+		}
+		if (fits)
+			return lengths;
+		for (uint32_t &frequency : frequencies)
+			frequency = (frequency + 1) / 2;
+	}
+}
+
+// The canonical code of each symbol
+static std::vector<uint32_t> MakeCodes(const std::vector<uint8_t> &lengths)
+{
+	uint32_t count[MAX_CODE_BITS + 1] = {}, next[MAX_CODE_BITS + 1] = {};
+	for (const uint8_t &length : lengths)
+		count[length]++;
+	count[0] = 0;
+	for (uint32_t bits = 1, code = 0; bits <= MAX_CODE_BITS; bits++) {
+		code = (code + count[bits - 1]) << 1;
+		next[bits] = code;
+	}
+	std::vector<uint32_t> codes(lengths.size(), 0);
+	for (size_t symbol = 0; symbol < lengths.size(); symbol++) {
+		if (lengths[symbol] != 0)
+			codes[symbol] = next[lengths[symbol]]++;
+	}
+	return codes;
+}
+
+static void WriteSymbol(BitWriter &writer, const uint32_t &symbol, const std::vector<uint8_t> &lengths, const std::vector<uint32_t> &codes)
+{
+	if (lengths[symbol] == 0)
+		throw "The symbol has no code";
+	writer.WriteCode(codes[symbol], lengths[symbol]);
+}
+
+// The symbols and the end of block with the given codes
+static void WriteTokens(BitWriter &writer, const Token *tokens, const size_t &count, const std::vector<uint8_t> &litLengths,
+	const std::vector<uint8_t> &distLengths)
+{
+	std::vector<uint32_t> litCodes = MakeCodes(litLengths), distCodes = MakeCodes(distLengths);
+	for (size_t i = 0; i < count; i++) {
+		if (tokens[i].length == 0) {
+			WriteSymbol(writer, tokens[i].value, litLengths, litCodes);
+			continue;
+		}
+		uint32_t extra;
+		uint32_t symbol = LengthSymbol(tokens[i].length, extra);
+		WriteSymbol(writer, symbol, litLengths, litCodes);
+		writer.Write(extra, LengthExtra(symbol));
+		symbol = DistanceSymbol(tokens[i].value, extra);
+		WriteSymbol(writer, symbol, distLengths, distCodes);
+		writer.Write(extra, DistanceExtra(symbol));
+	}
+	WriteSymbol(writer, END_OF_BLOCK, litLengths, litCodes);
+}
+
+// The beginning of a dynamic block up to the lengths of the code length code
+static void WriteCodeLengthCode(BitWriter &writer, const bool &final, const uint32_t &litCount, const uint32_t &distCount,
+	const std::vector<uint8_t> &codeLengths)
+{
+	uint32_t codeLengthCount = CODE_LENGTH_SYMBOLS;
+	while (codeLengthCount > 4 && codeLengths[g_aCodeLengthOrder[codeLengthCount - 1]] == 0)
+		codeLengthCount--;
+	writer.Write(final ? 1 : 0, 1);
+	writer.Write(2, 2);
+	writer.Write(litCount - 257, 5);
+	writer.Write(distCount - 1, 5);
+	writer.Write(codeLengthCount - 4, 4);
+	for (uint32_t i = 0; i < codeLengthCount; i++)
+		writer.Write(codeLengths[g_aCodeLengthOrder[i]], 3);
+}
+
+// The header of a dynamic block for the given literal/length and distance code lengths. The code lengths are
+// run-length encoded with the symbols 16, 17 and 18
+static void WriteDynamicHeader(BitWriter &writer, const bool &final, const std::vector<uint8_t> &litLengths,
+	const std::vector<uint8_t> &distLengths)
+{
+	std::vector<uint8_t> lengths(litLengths);
+	lengths.insert(lengths.end(), distLengths.begin(), distLengths.end());
+	std::vector<Token> symbols; // The code length symbols and their extra bits
+	for (size_t i = 0; i < lengths.size();) {
+		size_t run = 1;
+		while (i + run < lengths.size() && lengths[i + run] == lengths[i])
+			run++;
+		if (lengths[i] == 0 && run >= 3) {
+			size_t count = std::min<size_t>(run, 138);
+			symbols.push_back(count >= 11 ? Token{ 18, (uint32_t)count - 11 } : Token{ 17, (uint32_t)count - 3 });
+			i += count;
+		}
+		else if (lengths[i] != 0 && run >= 4) {
+			size_t count = std::min<size_t>(run - 1, 6);
+			symbols.push_back({ lengths[i], 0 });
+			symbols.push_back({ 16, (uint32_t)count - 3 });
+			i += count + 1;
+		}
+		else {
+			symbols.push_back({ lengths[i], 0 });
+			i++;
+		}
+	}
+
+	std::vector<uint32_t> frequencies(CODE_LENGTH_SYMBOLS, 0);
+	for (const Token &symbol : symbols)
+		frequencies[symbol.length]++;
+	std::vector<uint8_t> codeLengths = MakeCodeLengths(frequencies, MAX_CODE_LENGTH_BITS);
+	WriteCodeLengthCode(writer, final, (uint32_t)litLengths.size(), (uint32_t)distLengths.size(), codeLengths);
+	std::vector<uint32_t> codes = MakeCodes(codeLengths);
+	for (const Token &symbol : symbols) {
+		WriteSymbol(writer, symbol.length, codeLengths, codes);
+		if (symbol.length >= 16)
+			writer.Write(symbol.value, symbol.length == 16 ? 2 : (symbol.length == 17 ? 3 : 7));
+	}
+}
+
+static void WriteFixedBlock(BitWriter &writer, const bool &final, const Token *tokens, const size_t &count)
+{
+	std::vector<uint8_t> litLengths(288, 8), distLengths(DISTANCE_SYMBOLS + 2, 5);
+	std::fill(litLengths.begin() + 144, litLengths.begin() + 256, 9);
+	std::fill(litLengths.begin() + 256, litLengths.begin() + 280, 7);
+	writer.Write(final ? 1 : 0, 1);
+	writer.Write(1, 2);
+	WriteTokens(writer, tokens, count, litLengths, distLengths);
+}
+
+// Code lengths built from the symbols of the block, without the unused symbols at the end of the alphabets
+static void MakeBlockCodes(const Token *tokens, const size_t &count, std::vector<uint8_t> &litLengths, std::vector<uint8_t> &distLengths)
+{
+	std::vector<uint32_t> litFrequencies(LENGTH_SYMBOLS, 0), distFrequencies(DISTANCE_SYMBOLS, 0);
+	litFrequencies[END_OF_BLOCK] = 1;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t extra;
+		if (tokens[i].length == 0)
+			litFrequencies[tokens[i].value]++;
+		else {
+			litFrequencies[LengthSymbol(tokens[i].length, extra)]++;
+			distFrequencies[DistanceSymbol(tokens[i].value, extra)]++;
+		}
+	}
+	litLengths = MakeCodeLengths(litFrequencies, MAX_CODE_BITS);
+	distLengths = MakeCodeLengths(distFrequencies, MAX_CODE_BITS);
+	while (litLengths.size() > 257 && litLengths.back() == 0)
+		litLengths.pop_back();
+	while (distLengths.size() > 1 && distLengths.back() == 0)
+		distLengths.pop_back();
+}
+
+static void WriteDynamicBlock(BitWriter &writer, const bool &final, const Token *tokens, const size_t &count)
+{
+	std::vector<uint8_t> litLengths, distLengths;
+	MakeBlockCodes(tokens, count, litLengths, distLengths);
+	WriteDynamicHeader(writer, final, litLengths, distLengths);
+	WriteTokens(writer, tokens, count, litLengths, distLengths);
+}
+
+// The tokens in consecutive blocks of the given types, of about the same number of tokens each
+static binary_t Deflate(const std::vector<Token> &tokens, const std::vector<BlockType> &blocks)
+{
+	BitWriter writer;
+	for (size_t i = 0; i < blocks.size(); i++) {
+		size_t begin = tokens.size() * i / blocks.size(), end = tokens.size() * (i + 1) / blocks.size();
+		if (blocks[i] == BlockType::FIXED)
+			WriteFixedBlock(writer, i + 1 == blocks.size(), tokens.data() + begin, end - begin);
+		else
+			WriteDynamicBlock(writer, i + 1 == blocks.size(), tokens.data() + begin, end - begin);
+	}
+	return writer.Finish();
+}
+
+// zlib header with the given CMF byte and a valid FCHECK, the deflate stream and the Adler-32 of "scanlines"
+static binary_t MakeZlibStream(const byte_t &cmf, const binary_t &deflate, const binary_t &scanlines)
+{
+	binary_t stream = { cmf, (byte_t)((31 - (cmf * 256) % 31) % 31) };
+	stream.insert(stream.end(), deflate.begin(), deflate.end());
+	uint32_t adler = UpdateAdler32(1, scanlines.data(), scanlines.size());
+	for (int shift = 24; shift >= 0; shift -= 8)
+		stream.push_back((byte_t)(adler >> shift));
+	return stream;
+}
+
+// "scanlines" in a single stored block
+static binary_t MakeStoredStream(const byte_t &cmf, const binary_t &scanlines)
+{
+	size_t size = scanlines.size();
+	binary_t deflate = { 1, (byte_t)size, (byte_t)(size >> 8), (byte_t)~size, (byte_t)(~size >> 8) };
+	deflate.insert(deflate.end(), scanlines.begin(), scanlines.end());
+	return MakeZlibStream(cmf, deflate, scanlines);
+}
+
+// Rows of "width" pixels with filter 0 and the pixel values of "pixel"
+template <class Pixel>
+static binary_t MakeScanlines(const uint32_t &width, const uint32_t &height, const Pixel &pixel)
+{
+	binary_t scanlines;
+	for (uint32_t y = 0; y < height; y++) {
+		scanlines.push_back(0);
+		for (uint32_t x = 0; x < width; x++)
+			scanlines.push_back(pixel(x, y));
+	}
+	return scanlines;
+}
+
+// Decodes the image with "decoder", returns the error or nullptr if the rows are the expected ones
+static const char *DecodeStream(Decoder &decoder, const binary_t &stream, const binary_t &scanlines, const uint32_t &width,
+	const size_t &chunkSize)
+{
+	uint32_t height = (uint32_t)(scanlines.size() / (width + 1));
+	binary_t png = MakeTestStreamPNG(width, height, 0, 8, stream, chunkSize);
+	Image image;
+	try {
+		if (!decoder.Decode(png.data(), png.size(), image))
+			return decoder.GetError();
+	}
+	catch (const char *error) {
+		return error;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		if (memcmp(image.Row(y), scanlines.data() + (size_t)y * (width + 1) + 1, width) != 0)
+			return "Wrong image rows";
+	}
+	return nullptr;
+}
+
+static bool IsError(const char *error, const char *expected)
+{
+	return error != nullptr && strcmp(error, expected) == 0;
+}
+
+template <class Function>
+static bool Throws(const Function &function, const char *expected)
+{
+	try {
+		function();
+	}
+	catch (const char *error) {
+		return IsError(error, expected);
+	}
+	return false;
+}
+
+// A single dynamic block with the given code lengths in its header. The tokens are written with "tokenDistLengths",
+// which may differ from the distance code of the header to use codes that it doesn't have. Without an end-of-block
+// code only the header is written
+static binary_t MakeDynamicStream(const std::vector<Token> &tokens, const std::vector<uint8_t> &litLengths, const std::vector<uint8_t> &distLengths,
+	const std::vector<uint8_t> &tokenDistLengths, const binary_t &scanlines)
+{
+	BitWriter writer;
+	WriteDynamicHeader(writer, true, litLengths, distLengths);
+	if (litLengths[END_OF_BLOCK] != 0)
+		WriteTokens(writer, tokens.data(), tokens.size(), litLengths, tokenDistLengths);
+	return MakeZlibStream(0x78, writer.Finish(), scanlines);
+}
+
+int main()
+{
+	Decoder decoder, pipelined;
+	pipelined.SetPipelined(true);
+	Decoder *decoders[] = { &decoder, &pipelined };
+
+	// Streams from zlib 9: a fixed block and a dynamic block
+	static const binary_t zlibFixed = {
+		0x78, 0xDA, 0x63, 0x60, 0x60, 0x64, 0x62, 0x66, 0x61, 0x65, 0x63, 0xE7, 0xE0, 0xE4, 0xE2, 0xE6, 0xE1, 0xE5, 0xE3, 0x67,
+		0x20, 0x5D, 0x00, 0x00, 0x3A, 0xB4, 0x01, 0xE1
+	};
+	static const binary_t zlibDynamic = {
+		0x78, 0xDA, 0x85, 0xCF, 0xB1, 0x0D, 0xC0, 0x40, 0x10, 0x02, 0x41, 0x5A, 0x45, 0x3A, 0x88, 0x08, 0xE9, 0x5F, 0x76, 0x03,
+		0xE8, 0x49, 0x26, 0x65, 0x71, 0x8F, 0xE1, 0xE4, 0xB0, 0x9A, 0xE0, 0x4C, 0x29, 0x9D, 0xE0, 0x22, 0x57, 0x9C, 0xE0, 0xA8,
+		0x5A, 0x99, 0xE0, 0x1A, 0x89, 0x9E, 0xFC, 0x27, 0xCB, 0x58, 0x13, 0xBC, 0x32, 0x3F, 0xE9, 0x66, 0x66, 0xA4
+	};
+	binary_t fixedScanlines = MakeScanlines(16, 4, [](const uint32_t &x, const uint32_t &) { return (byte_t)x; });
+	binary_t dynamicScanlines = MakeScanlines(32, 8, [](const uint32_t &x, const uint32_t &y) { return (byte_t)"deflate"[x * y % 7]; });
+
+	// 128 random rows, the same rows again(a copy from 32K back) and rows of zeros(runs with distance 1)
+	std::mt19937 random(1);
+	binary_t matchScanlines = MakeScanlines(MATCH_TEST_WIDTH, MATCH_TEST_ROWS, [&random](const uint32_t &, const uint32_t &) { return (byte_t)random(); });
+	binary_t copy = matchScanlines;
+	matchScanlines.insert(matchScanlines.end(), copy.begin(), copy.end());
+	matchScanlines.resize(matchScanlines.size() + 8 * (MATCH_TEST_WIDTH + 1), 0);
+	std::vector<Token> tokens = Tokenize(matchScanlines, { 1, MAX_MATCH_DISTANCE });
+	CHECK(std::any_of(tokens.begin(), tokens.end(), [](const Token &token) { return token.length != 0 && token.value == 1; }));
+	CHECK(std::any_of(tokens.begin(), tokens.end(), [](const Token &token) { return token.length != 0 && token.value == MAX_MATCH_DISTANCE; }));
+	CHECK(std::any_of(tokens.begin(), tokens.end(), [](const Token &token) { return token.length == MAX_MATCH_LENGTH; }));
+	static const std::vector<BlockType> blockLists[] = {
+		{ BlockType::FIXED }, { BlockType::DYNAMIC }, { BlockType::FIXED, BlockType::DYNAMIC, BlockType::DYNAMIC, BlockType::FIXED }
+	};
+	// The IDAT chunks of 1 and 7 bytes split the codes, extra bits and matches between the chunks
+	static const size_t chunkSizes[] = { 1, 7, 1 << 20 };
+
+	for (Decoder *tested : decoders) {
+		// zlib header: CM must be 8 and CINFO at most 7, any window of 256 bytes to 32K is valid
+		CHECK(DecodeStream(*tested, MakeStoredStream(0x78, fixedScanlines), fixedScanlines, 16, 1000) == nullptr);
+		CHECK(DecodeStream(*tested, MakeStoredStream(0x08, fixedScanlines), fixedScanlines, 16, 1000) == nullptr);
+		CHECK(IsError(DecodeStream(*tested, MakeStoredStream(0x77, fixedScanlines), fixedScanlines, 16, 1000), "The zlib stream is not compressed with deflate(CM)!"));
+		CHECK(IsError(DecodeStream(*tested, MakeStoredStream(0x79, fixedScanlines), fixedScanlines, 16, 1000), "The zlib stream is not compressed with deflate(CM)!"));
+		CHECK(IsError(DecodeStream(*tested, MakeStoredStream(0x0F, fixedScanlines), fixedScanlines, 16, 1000), "The zlib stream is not compressed with deflate(CM)!"));
+		CHECK(IsError(DecodeStream(*tested, MakeStoredStream(0x88, fixedScanlines), fixedScanlines, 16, 1000), "The zlib window is larger than 32K(CINFO)!"));
+		CHECK(IsError(DecodeStream(*tested, MakeStoredStream(0xF8, fixedScanlines), fixedScanlines, 16, 1000), "The zlib window is larger than 32K(CINFO)!"));
+
+		for (const size_t &chunkSize : chunkSizes) {
+			CHECK(DecodeStream(*tested, zlibFixed, fixedScanlines, 16, chunkSize) == nullptr);
+			CHECK(DecodeStream(*tested, zlibDynamic, dynamicScanlines, 32, chunkSize) == nullptr);
+			for (const std::vector<BlockType> &blocks : blockLists) {
+				binary_t stream = MakeZlibStream(0x78, Deflate(tokens, blocks), matchScanlines);
+				CHECK(DecodeStream(*tested, stream, matchScanlines, MATCH_TEST_WIDTH, chunkSize) == nullptr);
+			}
+		}
+
+		// Code length codes: three codes of 1 bit don't fit. An incomplete code is accepted, but its unassigned
+		// code("11" after the codes "0" and "10") can't be decoded
+		std::vector<uint8_t> codeLengths(CODE_LENGTH_SYMBOLS, 0);
+		codeLengths[0] = codeLengths[9] = codeLengths[1] = 1;
+		BitWriter overSubscribed;
+		WriteCodeLengthCode(overSubscribed, true, 257, 1, codeLengths);
+		binary_t stream = MakeZlibStream(0x78, overSubscribed.Finish(), fixedScanlines);
+		CHECK(IsError(DecodeStream(*tested, stream, fixedScanlines, 16, 1000), "Huffman code is over-subscribed!"));
+
+		codeLengths.assign(CODE_LENGTH_SYMBOLS, 0);
+		codeLengths[9] = 1;
+		codeLengths[1] = 2;
+		BitWriter incomplete;
+		WriteCodeLengthCode(incomplete, true, 257, 1, codeLengths);
+		incomplete.WriteCode(3, 2);
+		stream = MakeZlibStream(0x78, incomplete.Finish(), fixedScanlines);
+		CHECK(IsError(DecodeStream(*tested, stream, fixedScanlines, 16, 1000), "Invalid Huffman code found in the stream!"));
+	}
+
+	// HuffmanTable::Build(): an over-subscribed code or a code longer than 15 bits throws, no codes give an empty
+	// table and an incomplete code is accepted, but its unassigned codes throw when they are decoded
+	std::vector<HuffmanEntry> storage(DIST_TABLE_SIZE);
+	HuffmanTable table(storage.data(), storage.size(), DIST_ROOT_BITS);
+	static const uint8_t overSubscribed[] = { 1, 2, 2, 2 }, tooLong[] = { 16, 1 }, none[] = { 0, 0 }, single[] = { 0, 1 };
+	CHECK(Throws([&]() { table.Build(overSubscribed, sizeof(overSubscribed), Alphabet::DISTANCES); }, "Huffman code is over-subscribed!"));
+	CHECK(Throws([&]() { table.Build(tooLong, sizeof(tooLong), Alphabet::DISTANCES); }, "Huffman code length is too long!"));
+	table.Build(none, sizeof(none), Alphabet::DISTANCES);
+	CHECK(table.Empty());
+	table.Build(single, sizeof(single), Alphabet::DISTANCES);
+	CHECK(!table.Empty());
+	static const byte_t codes[] = { 0x02 }; // "0", then the unassigned "1"
+	BitReader reader;
+	reader.SetData(codes, sizeof(codes));
+	const HuffmanEntry &entry = table.Decode(reader);
+	CHECK(entry.type == HuffmanSymbol::DISTANCE && entry.value == 2 && entry.bits == 1);
+	CHECK(Throws([&]() { table.Decode(reader); }, "Invalid Huffman code found in the stream!"));
+
+	// The same rules in dynamic blocks. The zeros at the beginning of the rows are copied with distance 1 or 2
+	binary_t runScanlines = MakeScanlines(16, 4, [](const uint32_t &x, const uint32_t &y) { return (byte_t)(x < 8 ? 0 : x * y); });
+	std::vector<Token> literals = Tokenize(runScanlines, {}), distance1 = Tokenize(runScanlines, { 1 }), distance2 = Tokenize(runScanlines, { 2 });
+	std::vector<uint8_t> literalLengths, distance1Lengths, distance2Lengths, unused;
+	MakeBlockCodes(literals.data(), literals.size(), literalLengths, unused);
+	MakeBlockCodes(distance1.data(), distance1.size(), distance1Lengths, unused);
+	MakeBlockCodes(distance2.data(), distance2.size(), distance2Lengths, unused);
+	const std::vector<uint8_t> noDistances(1, 0), singleDistance(1, 1), twoDistances(2, 1);
+	std::vector<uint8_t> incompleteLengths(distance1Lengths.size(), 0), overSubscribedLengths(257, 8), noEndLengths(257, 8);
+	for (size_t symbol = 0; symbol < distance1Lengths.size(); symbol++)
+		incompleteLengths[symbol] = distance1Lengths[symbol] != 0 ? 9 : 0; // Fewer than 512 codes
+	noEndLengths[END_OF_BLOCK] = 0;
+	for (Decoder *tested : decoders) {
+		// A single distance code(distance 1) is accepted, using its unassigned code throws
+		CHECK(DecodeStream(*tested, MakeDynamicStream(distance1, distance1Lengths, singleDistance, singleDistance, runScanlines), runScanlines, 16, 1000) == nullptr);
+		CHECK(IsError(DecodeStream(*tested, MakeDynamicStream(distance2, distance2Lengths, singleDistance, twoDistances, runScanlines), runScanlines, 16, 1000),
+			"Invalid Huffman code found in the stream!"));
+		// An incomplete literal/length code is accepted too
+		CHECK(DecodeStream(*tested, MakeDynamicStream(distance1, incompleteLengths, singleDistance, singleDistance, runScanlines), runScanlines, 16, 1000) == nullptr);
+		// 257 codes of 8 bits don't fit
+		CHECK(IsError(DecodeStream(*tested, MakeDynamicStream({}, overSubscribedLengths, singleDistance, singleDistance, runScanlines), runScanlines, 16, 1000),
+			"Huffman code is over-subscribed!"));
+		CHECK(IsError(DecodeStream(*tested, MakeDynamicStream({}, noEndLengths, singleDistance, singleDistance, runScanlines), runScanlines, 16, 1000),
+			"The block has no end-of-block code!"));
+		// A block without distance codes can have only literals
+		CHECK(DecodeStream(*tested, MakeDynamicStream(literals, literalLengths, noDistances, noDistances, runScanlines), runScanlines, 16, 1000) == nullptr);
+		CHECK(IsError(DecodeStream(*tested, MakeDynamicStream(distance1, distance1Lengths, noDistances, singleDistance, runScanlines), runScanlines, 16, 1000),
+			"Distance alphabet contains 0 entries, but a length symbol was found in the stream!"));
+	}
+	return TestResult();
+}
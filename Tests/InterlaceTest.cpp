@@ -0,0 +1,88 @@
+// Decodes interlaced images that are large enough for the thread pool and compares them with the images
+// reconstructed on the calling thread, for every format, a converted output and the previews
+#include <iostream>
+#include <thread>
+#include "Decoder.h"
+#include "TestUtils.h"
+
+#define POOL_THREADS 4
+#define SHARED_POOL_DECODES 200 // Decodes of each of the two threads that share a pool
+
+struct TestImage {
+	uint32_t width;
+	uint32_t height;
+	uint8_t colorType;
+	uint8_t bitDepth;
+};
+
+int main()
+{
+	// Every image has more than PARALLEL_PASSES_MIN_SIZE bytes of image data. The odd sizes leave some passes
+	// with partial blocks at the right and bottom edges
+	static const TestImage images[] = {
+		{ 2403, 1001, 0, 1 }, { 1201, 999, 0, 2 }, { 700, 803, 0, 4 }, { 601, 501, 0, 8 }, { 411, 333, 0, 16 },
+		{ 403, 299, 2, 8 }, { 301, 223, 2, 16 }, { 1203, 901, 3, 2 }, { 603, 517, 3, 8 }, { 379, 401, 4, 8 },
+		{ 333, 211, 4, 16 }, { 321, 227, 6, 8 }, { 257, 199, 6, 16 }
+	};
+	static const OutputFormat formats[] = { OutputFormat::NATIVE, OutputFormat::BGRA8_PREMULTIPLIED };
+
+	ThreadPool pool(POOL_THREADS);
+	Decoder serial, parallel;
+	parallel.SetThreadPool(&pool);
+	Image expected, image;
+	uint32_t seed = 1;
+	for (const TestImage &test : images) {
+		binary_t png = MakeTestPNG(test.width, test.height, test.colorType, test.bitDepth, true, seed++);
+		for (const OutputFormat &format : formats) {
+			for (uint32_t passes = 0; passes < ADAM7_PASSES; passes++) {
+				serial.SetOutputFormat(format);
+				serial.SetPreviewPasses(passes);
+				parallel.SetOutputFormat(format);
+				parallel.SetPreviewPasses(passes);
+				CHECK(serial.Decode(png.data(), png.size(), expected));
+				CHECK(parallel.Decode(png.data(), png.size(), image));
+				if (passes == 0)
+					CHECK(serial.GetDataSize() >= PARALLEL_PASSES_MIN_SIZE);
+				if (!SameImage(expected, image)) {
+					std::cerr << "Color type " << (int)test.colorType << ", bit depth " << (int)test.bitDepth << ", output format "
+						<< (int)format << ", passes " << passes << ": the images are different\n";
+					CHECK(SameImage(expected, image));
+				}
+			}
+		}
+	}
+
+	// A decode on a thread of the pool reconstructs the passes itself instead of waiting for its own pool
+	binary_t png = MakeTestPNG(640, 480, 6, 8, true, seed);
+	serial.SetOutputFormat(OutputFormat::NATIVE);
+	serial.SetPreviewPasses(0);
+	parallel.SetOutputFormat(OutputFormat::NATIVE);
+	parallel.SetPreviewPasses(0);
+	CHECK(serial.Decode(png.data(), png.size(), expected));
+	bool decoded = false;
+	pool.Run(1, [&](const size_t &, const size_t &) {
+		decoded = parallel.Decode(png.data(), png.size(), image);
+	});
+	CHECK(decoded);
+	CHECK(SameImage(expected, image));
+
+	// Two decoders on two threads share the pool, their batches must not mix
+	png = MakeTestPNG(900, 700, 6, 8, true, seed + 1);
+	CHECK(serial.Decode(png.data(), png.size(), expected));
+	size_t mismatches[2] = { 0, 0 };
+	auto decodeShared = [&](const size_t &thread) {
+		Decoder decoder;
+		Image output;
+		decoder.SetThreadPool(&pool);
+		for (int i = 0; i < SHARED_POOL_DECODES; i++) {
+			if (!decoder.Decode(png.data(), png.size(), output) || !SameImage(expected, output))
+				mismatches[thread]++;
+		}
+	};
+	std::thread first(decodeShared, 0), second(decodeShared, 1);
+	first.join();
+	second.join();
+	CHECK(mismatches[0] == 0);
+	CHECK(mismatches[1] == 0);
+	return TestResult();
+}
@@ -0,0 +1,158 @@
+#include "TestUtils.h"
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <algorithm> // used for std::min()
+#include "Adam7.h"
+#include "Adler32.h"
+#include "CRC32.h"
+
+#define STORED_BLOCK_SIZE 65535 // The largest uncompressed deflate block
+#define TEST_IDAT_SIZE 20000 // The image data is split in chunks of this size
+
+static int g_failures = 0;
+
+void ReportFailure(const char * condition, const char * file, const int & line)
+{
+	std::cerr << file << ":" << line << ": CHECK(" << condition << ") failed\n";
+	g_failures++;
+}
+
+int TestResult()
+{
+	if (g_failures == 0) {
+		std::cout << "All checks passed\n";
+		return 0;
+	}
+	std::cout << g_failures << " check(s) failed\n";
+	return 1;
+}
+
+static void AppendUInt32(binary_t &data, const uint32_t &value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		data.push_back((byte_t)(value >> shift));
+}
+
+static void AppendChunk(binary_t &png, const char *type, const byte_t *data, const size_t &size)
+{
+	AppendUInt32(png, (uint32_t)size);
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data, data + size);
+	AppendUInt32(png, UpdateCRC32(0, png.data() + start, png.size() - start));
+}
+
+// Random filtered scanlines of a reduced image
+static void AppendScanlines(binary_t &data, const uint32_t &width, const uint32_t &height, const size_t &bitsPerPixel, std::mt19937 &random)
+{
+	if (width == 0 || height == 0)
+		return;
+	size_t rowBytes = ((size_t)width * bitsPerPixel + 7) / 8;
+	for (uint32_t y = 0; y < height; y++) {
+		data.push_back((byte_t)(random() % 5));
+		for (size_t i = 0; i < rowBytes; i++)
+			data.push_back((byte_t)random());
+	}
+}
+
+static const byte_t g_aSignature[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+// The signature and the IHDR chunk
+static binary_t BeginTestPNG(const uint32_t &width, const uint32_t &height, const uint8_t &colorType, const uint8_t &bitDepth,
+	const bool &interlaced)
+{
+	binary_t png(g_aSignature, g_aSignature + sizeof(g_aSignature));
+	binary_t header;
+	AppendUInt32(header, width);
+	AppendUInt32(header, height);
+	header.push_back(bitDepth);
+	header.push_back(colorType);
+	header.push_back(0); // Deflate
+	header.push_back(0); // Adaptive filtering
+	header.push_back(interlaced ? 1 : 0);
+	AppendChunk(png, "IHDR", header.data(), header.size());
+	return png;
+}
+
+binary_t MakeTestPNG(const uint32_t & width, const uint32_t & height, const uint8_t & colorType, const uint8_t & bitDepth,
+	const bool & interlaced, const uint32_t & seed)
+{
+	static const uint32_t channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+	std::mt19937 random(seed);
+	binary_t png = BeginTestPNG(width, height, colorType, bitDepth, interlaced);
+
+	if (colorType == 3) {
+		binary_t palette(((size_t)1 << bitDepth) * 3);
+		for (byte_t &value : palette)
+			value = (byte_t)random();
+		AppendChunk(png, "PLTE", palette.data(), palette.size());
+	}
+
+	size_t bitsPerPixel = (size_t)channels[colorType] * bitDepth;
+	binary_t scanlines;
+	if (interlaced) {
+		for (uint32_t pass = 0; pass < ADAM7_PASSES; pass++)
+			AppendScanlines(scanlines, Adam7Passes[pass].Width(width), Adam7Passes[pass].Height(height), bitsPerPixel, random);
+	}
+	else
+		AppendScanlines(scanlines, width, height, bitsPerPixel, random);
+
+	// zlib stream of stored blocks
+	binary_t stream = { 0x78, 0x01 };
+	size_t position = 0;
+	do {
+		size_t size = std::min(scanlines.size() - position, (size_t)STORED_BLOCK_SIZE);
+		bool final = position + size == scanlines.size();
+		stream.push_back(final ? 1 : 0);
+		stream.push_back((byte_t)size);
+		stream.push_back((byte_t)(size >> 8));
+		stream.push_back((byte_t)~size);
+		stream.push_back((byte_t)(~size >> 8));
+		stream.insert(stream.end(), scanlines.begin() + position, scanlines.begin() + position + size);
+		position += size;
+	} while (position < scanlines.size());
+	AppendUInt32(stream, UpdateAdler32(1, scanlines.data(), scanlines.size()));
+
+	for (size_t offset = 0; offset < stream.size(); offset += TEST_IDAT_SIZE)
+		AppendChunk(png, "IDAT", stream.data() + offset, std::min(stream.size() - offset, (size_t)TEST_IDAT_SIZE));
+	AppendChunk(png, "IEND", nullptr, 0);
+	return png;
+}
+
+binary_t MakeTestHeaderPNG(const uint32_t & width, const uint32_t & height, const uint8_t & colorType, const uint8_t & bitDepth)
+{
+	// A zlib stream with a single empty stored block
+	static const binary_t stream = { 0x78, 0x01, 0x01, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01 };
+	return MakeTestStreamPNG(width, height, colorType, bitDepth, stream, stream.size());
+}
+
+binary_t MakeTestStreamPNG(const uint32_t & width, const uint32_t & height, const uint8_t & colorType, const uint8_t & bitDepth,
+	const binary_t & stream, const size_t & chunkSize)
+{
+	binary_t png = BeginTestPNG(width, height, colorType, bitDepth, false);
+	for (size_t offset = 0; offset < stream.size(); offset += chunkSize)
+		AppendChunk(png, "IDAT", stream.data() + offset, std::min(stream.size() - offset, chunkSize));
+	AppendChunk(png, "IEND", nullptr, 0);
+	return png;
+}
+
+bool WriteTestFile(const std::string & path, const binary_t & data)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char *)data.data(), data.size());
+	return file.good();
+}
+
+bool SameImage(const Image & a, const Image & b)
+{
+	if (a.Width() != b.Width() || a.Height() != b.Height() || a.Format().channels != b.Format().channels ||
+		a.Format().bitDepth != b.Format().bitDepth)
+		return false;
+	for (uint32_t y = 0; y < a.Height(); y++) {
+		if (memcmp(a.Row(y), b.Row(y), a.RowBytes()) != 0)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <Binary.h>
+#include "Image.h"
+
+// Reports the failed condition and continues the test, see TestResult()
+#define CHECK(condition) ((condition) ? (void)0 : ReportFailure(#condition, __FILE__, __LINE__))
+
+void ReportFailure(const char *condition, const char *file, const int &line);
+// Prints the number of failed checks, the result is the exit code of the test
+int TestResult();
+
+// Builds a PNG datastream with random scanlines(the filter types are random too, every byte sequence is a valid
+// filtered row). The image data is stored in uncompressed deflate blocks split over a few IDAT chunks, so any
+// size and format can be made without an encoder. Indexed images get a palette with 2^bitDepth entries
+binary_t MakeTestPNG(const uint32_t &width, const uint32_t &height, const uint8_t &colorType, const uint8_t &bitDepth,
+	const bool &interlaced, const uint32_t &seed);
+// A PNG with the given IHDR, but only an empty zlib stream as image data(and no palette). For the checks
+// that must reject the image before its data is read
+binary_t MakeTestHeaderPNG(const uint32_t &width, const uint32_t &height, const uint8_t &colorType, const uint8_t &bitDepth);
+// A PNG with the given IHDR whose image data is "stream", split in IDAT chunks of "chunkSize" bytes(no palette)
+binary_t MakeTestStreamPNG(const uint32_t &width, const uint32_t &height, const uint8_t &colorType, const uint8_t &bitDepth,
+	const binary_t &stream, const size_t &chunkSize);
+bool WriteTestFile(const std::string &path, const binary_t &data);
+// Same size, format and rows
+bool SameImage(const Image &a, const Image &b);
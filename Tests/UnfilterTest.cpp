@@ -0,0 +1,96 @@
+// Reconstructs random rows with the kernels of every instruction set the CPU supports and compares them with
+// the scalar kernels and a plain implementation of the filters, for every pixel size and filter type. The bytes
+// after the row must stay unchanged, the kernels may only read them
+#include <iostream>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include "PNGUnfilter.h"
+#include "TestUtils.h"
+
+#define GUARD_BYTE 0xA5
+#define MAX_TEST_PIXELS 80 // Every row length up to this, then a few longer ones
+
+// The filters as the specification describes them, one byte at a time
+static void ReferenceUnfilter(const byte_t &filter, byte_t *row, const byte_t *previous, const size_t &rowBytes, const size_t &pixelSize)
+{
+	for (size_t i = 0; i < rowBytes; i++) {
+		int a = i >= pixelSize ? row[i - pixelSize] : 0;
+		int b = previous[i];
+		int c = i >= pixelSize ? previous[i - pixelSize] : 0;
+		int predictor = 0;
+		switch ((FilterType)filter) {
+		case FilterType::NONE: predictor = 0; break;
+		case FilterType::SUB: predictor = a; break;
+		case FilterType::UP: predictor = b; break;
+		case FilterType::AVERAGE: predictor = (a + b) / 2; break;
+		case FilterType::PAETH: {
+			int p = a + b - c;
+			int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+			predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+			break;
+		}
+		}
+		row[i] = (byte_t)(row[i] + predictor);
+	}
+}
+
+// Unfilters a copy of "filtered" in a buffer with guard bytes after the row, returns false if a guard byte changed
+static bool UnfilterGuarded(const PNGUnfilter &unfilter, const byte_t &filter, const binary_t &filtered, const binary_t &previous,
+	binary_t &result)
+{
+	size_t rowBytes = filtered.size() - UNFILTER_PADDING;
+	result = filtered;
+	memset(result.data() + rowBytes, GUARD_BYTE, UNFILTER_PADDING);
+	unfilter.UnfilterRow(filter, result.data(), previous.data(), rowBytes);
+	for (size_t i = rowBytes; i < result.size(); i++) {
+		if (result[i] != GUARD_BYTE)
+			return false;
+	}
+	result.resize(rowBytes);
+	return true;
+}
+
+int main()
+{
+	static const size_t pixelSizes[] = { 1, 2, 3, 4, 6, 8 };
+	static const InstructionSet levels[] = { InstructionSet::SSE2, InstructionSet::SSE41, InstructionSet::AVX2 };
+	std::vector<size_t> lengths;
+	for (size_t pixels = 1; pixels <= MAX_TEST_PIXELS; pixels++)
+		lengths.push_back(pixels);
+	lengths.insert(lengths.end(), { 127, 255, 1001, 4099 });
+
+	std::mt19937 random(1);
+	for (const size_t &pixelSize : pixelSizes) {
+		PNGUnfilter scalar(pixelSize, InstructionSet::SCALAR);
+		CHECK(scalar.GetInstructionSet() == InstructionSet::SCALAR);
+		for (const size_t &pixels : lengths) {
+			size_t rowBytes = pixels * pixelSize;
+			binary_t filtered(rowBytes + UNFILTER_PADDING), previous(rowBytes + UNFILTER_PADDING);
+			for (byte_t &value : filtered)
+				value = (byte_t)random();
+			for (byte_t &value : previous)
+				value = (byte_t)random();
+			for (byte_t filter = 0; filter <= (byte_t)FilterType::PAETH; filter++) {
+				binary_t expected(filtered.begin(), filtered.begin() + rowBytes);
+				ReferenceUnfilter(filter, expected.data(), previous.data(), rowBytes, pixelSize);
+				binary_t result;
+				CHECK(UnfilterGuarded(scalar, filter, filtered, previous, result));
+				CHECK(result == expected);
+
+				for (const InstructionSet &level : levels) {
+					PNGUnfilter unfilter(pixelSize, level);
+					if (unfilter.GetInstructionSet() != level)
+						continue; // Not supported by the CPU, the lower level is tested already
+					binary_t before = previous;
+					if (!UnfilterGuarded(unfilter, filter, filtered, previous, result) || result != expected || previous != before) {
+						std::cerr << "Instruction set " << (int)level << ", pixel size " << pixelSize << ", " << pixels <<
+							" pixels, filter " << (int)filter << "\n";
+						CHECK(!"The row differs from the scalar one");
+					}
+				}
+			}
+		}
+	}
+	return TestResult();
+}
@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+#include <algorithm> // used for std::max()
+
+static thread_local bool t_bWorker = false;
+
+ThreadPool::ThreadPool(size_t threads)
+	: m_pTask(nullptr), m_uGeneration(0), m_uActive(0), m_bStop(false)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < threads; i++)
+		m_vQueues.emplace_back(new WorkQueue());
+	for (size_t i = 0; i < threads; i++)
+		m_vThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_oLock);
+		m_bStop = true;
+	}
+	m_oStart.notify_all();
+	for (std::thread &thread : m_vThreads)
+		thread.join();
+}
+
+void ThreadPool::Run(const size_t & count, const PoolTask & task)
+{
+	std::lock_guard<std::mutex> batch(m_oBatchLock);
+
+	// Every worker starts with a contiguous range of the indices
+	size_t workers = m_vThreads.size();
+	for (size_t i = 0; i < workers; i++) {
+		std::lock_guard<std::mutex> lock(m_vQueues[i]->lock);
+		m_vQueues[i]->begin = count * i / workers;
+		m_vQueues[i]->end = count * (i + 1) / workers;
+	}
+
+	std::unique_lock<std::mutex> lock(m_oLock);
+	m_pTask = &task;
+	m_pError = nullptr;
+	m_uActive = workers;
+	m_uGeneration++;
+	m_oStart.notify_all();
+	m_oDone.wait(lock, [this]() { return m_uActive == 0; });
+	m_pTask = nullptr;
+	if (m_pError)
+		std::rethrow_exception(m_pError);
+}
+
+bool ThreadPool::IsWorkerThread()
+{
+	return t_bWorker;
+}
+
+void ThreadPool::WorkerLoop(const size_t & worker)
+{
+	t_bWorker = true;
+	size_t generation = 0;
+	while (true) {
+		const PoolTask *task;
+		{
+			std::unique_lock<std::mutex> lock(m_oLock);
+			m_oStart.wait(lock, [this, generation]() { return m_bStop || m_uGeneration != generation; });
+			if (m_bStop)
+				return;
+			generation = m_uGeneration;
+			task = m_pTask;
+		}
+
+		size_t index;
+		while (NextTask(worker, index)) {
+			try {
+				(*task)(worker, index);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_oLock);
+				if (!m_pError)
+					m_pError = std::current_exception();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_oLock);
+		if (--m_uActive == 0)
+			m_oDone.notify_all();
+	}
+}
+
+bool ThreadPool::NextTask(const size_t & worker, size_t & index)
+{
+	{
+		WorkQueue &own = *m_vQueues[worker];
+		std::lock_guard<std::mutex> lock(own.lock);
+		if (own.begin < own.end) {
+			index = own.begin++;
+			return true;
+		}
+	}
+
+	// The tasks don't create new tasks, so once every range is seen empty the batch is done for this worker
+	for (size_t i = 1; i < m_vQueues.size(); i++) {
+		WorkQueue &victim = *m_vQueues[(worker + i) % m_vQueues.size()];
+		std::lock_guard<std::mutex> lock(victim.lock);
+		if (victim.begin < victim.end) {
+			index = --victim.end;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// Runs a task for "worker" on the given index
+typedef std::function<void(const size_t &worker, const size_t &index)> PoolTask;
+
+
+// Fixed set of worker threads that run batches of independent tasks. Each worker has its own range of
+// task indices and takes them from the front. A worker whose range is empty steals from the back of the
+// ranges of the others, so the load stays balanced even when some tasks take much longer than the rest.
+// Running a batch doesn't allocate memory. The pool runs one batch at a time: Run() may be called from several
+// threads(e.g. by decoders sharing the pool), a call waits until the batch of the previous one is finished.
+class ThreadPool
+{
+public:
+	// 0 threads means one per hardware thread
+	ThreadPool(size_t threads = 0);
+	ThreadPool(const ThreadPool &) = delete;
+	~ThreadPool();
+
+	ThreadPool &operator = (const ThreadPool &) = delete;
+
+	size_t Size() const { return m_vThreads.size(); }
+	// Runs task(worker, i) for every i in [0, count) and waits for all of them. The first exception
+	// thrown by a task is rethrown here after the rest of the tasks are finished. The calling thread only
+	// waits, so a task must not call Run() of its own pool(it would wait for its own batch)
+	void Run(const size_t &count, const PoolTask &task);
+	// True on the worker threads of every pool, e.g. to avoid splitting the work of a task once more
+	static bool IsWorkerThread();
+
+private: // Types
+	struct WorkQueue {
+		std::mutex lock;
+		size_t begin; // The indices in [begin, end) are not taken yet
+		size_t end;
+	};
+
+private: // Methods
+	void WorkerLoop(const size_t &worker);
+	// Takes the next index from the worker's own queue or steals one, returns false when all queues are empty
+	bool NextTask(const size_t &worker, size_t &index);
+
+private: // Variables
+	std::vector<std::thread> m_vThreads;
+	std::vector<std::unique_ptr<WorkQueue>> m_vQueues;
+	std::mutex m_oBatchLock; // Held by Run() for the whole batch, so the batches of different callers don't mix
+	std::mutex m_oLock; // Guards the variables below
+	std::condition_variable m_oStart;
+	std::condition_variable m_oDone;
+	const PoolTask *m_pTask;
+	size_t m_uGeneration; // Incremented for every Run()
+	size_t m_uActive; // Workers that haven't finished the current batch
+	std::exception_ptr m_pError;
+	bool m_bStop;
+};
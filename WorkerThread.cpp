@@ -0,0 +1,62 @@
+#include "WorkerThread.h"
+
+WorkerThread::WorkerThread()
+	: m_pJob(nullptr), m_bStop(false)
+{}
+
+WorkerThread::~WorkerThread()
+{
+	if (!m_oThread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_oLock);
+		m_bStop = true;
+	}
+	m_oStart.notify_all();
+	m_oThread.join();
+}
+
+void WorkerThread::Start(const WorkerJob & job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_oLock);
+		m_pJob = &job;
+		m_pError = nullptr;
+	}
+	if (!m_oThread.joinable())
+		m_oThread = std::thread(&WorkerThread::WorkerLoop, this);
+	else
+		m_oStart.notify_all();
+}
+
+void WorkerThread::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_oLock);
+	m_oDone.wait(lock, [this]() { return m_pJob == nullptr; });
+	if (m_pError)
+		std::rethrow_exception(m_pError);
+}
+
+void WorkerThread::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_oLock);
+	while (true) {
+		m_oStart.wait(lock, [this]() { return m_bStop || m_pJob != nullptr; });
+		if (m_bStop)
+			return;
+
+		const WorkerJob *job = m_pJob;
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			(*job)();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+		m_pError = error;
+		m_pJob = nullptr;
+		m_oDone.notify_all();
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// Job of a WorkerThread
+typedef std::function<void()> WorkerJob;
+
+
+// A single thread that is kept for many jobs, so starting a job doesn't create a thread. The thread is created
+// by the first Start() and runs one job at a time. It is stopped by the destructor.
+class WorkerThread
+{
+public:
+	WorkerThread();
+	WorkerThread(const WorkerThread &) = delete;
+	~WorkerThread();
+
+	WorkerThread &operator = (const WorkerThread &) = delete;
+
+	// Runs the job on the thread, the previous job must be finished(see Wait()). The job is not copied,
+	// so it must stay valid until Wait() returns
+	void Start(const WorkerJob &job);
+	// Waits for the job started last. An exception thrown by the job is rethrown here
+	void Wait();
+
+private: // Methods
+	void WorkerLoop();
+
+private: // Variables
+	std::thread m_oThread;
+	std::mutex m_oLock; // Guards the variables below
+	std::condition_variable m_oStart;
+	std::condition_variable m_oDone;
+	const WorkerJob *m_pJob; // nullptr when there is no job waiting or running
+	std::exception_ptr m_pError;
+	bool m_bStop;
+};